@@ -0,0 +1,813 @@
+// Benchmarks of the scan, parse and delete paths of FileSizeMgr on a generated directory tree.
+// Built as FileSizeMgrBench; every result is printed as one JSON object per line on stdout.
+#include "main.cpp"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <ctime>
+#endif
+
+class FileSizeMonitorBenchmark {
+public:
+    // Shape of the generated tree; the same spec and seed always produce the same tree
+    struct TreeSpec {
+        size_t fanout = 4;          // Subdirectories per directory
+        size_t depth = 3;           // Levels below the root
+        size_t files_per_dir = 50;
+        std::string sizes = "lognormal:10,2"; // fixed:SIZE, uniform:MIN-MAX or lognormal:MU,SIGMA (of ln bytes)
+        uint64_t seed = 42;
+    };
+
+    struct TreeStats {
+        size_t directories = 0;
+        size_t files = 0;
+        uintmax_t bytes = 0;
+    };
+
+    // Churn simulation: writers grow entries against a running monitor that trashes them at their limit
+    struct ChurnOptions {
+        bool enabled = false;
+        size_t entries = 8;
+        size_t writers = 4;
+        std::string rate = "20MB";     // Growth per writer and second
+        std::string step = "256KB";    // Growth per write
+        std::string limit = "64MB";    // Threshold of every entry
+        size_t files_per_subdir = 32;  // New files before a writer starts a new subdirectory
+        double seconds = 30;
+        int interval = 1;              // Check interval of the monitor
+        bool adaptive = false;
+    };
+
+    struct Options {
+        TreeSpec tree;
+        bool custom_tree = false;      // Tree options were given; churn entries otherwise start small
+        ChurnOptions churn;
+        std::filesystem::path root;
+        size_t repeat = 5;
+        size_t config_entries = 100000;
+        std::set<std::string> only;
+        bool keep = false;
+    };
+
+    explicit FileSizeMonitorBenchmark(Options options) : options_(std::move(options)) {}
+
+    int run() {
+        std::error_code ec;
+        std::filesystem::create_directories(options_.root, ec);
+        if (ec) {
+            std::cerr << "Cannot create " << options_.root.string() << ": " << ec.message() << std::endl;
+            return 1;
+        }
+        if (options_.churn.enabled) {
+            int status = runChurn();
+            if (!options_.keep) {
+                std::filesystem::remove_all(options_.root, ec);
+            }
+            FileSizeMonitor::flushLog();
+            return status;
+        }
+
+        std::filesystem::path scan_root = options_.root / "scan";
+        std::filesystem::remove_all(scan_root, ec);
+        TreeStats tree = generateTree(scan_root, options_.tree);
+        std::cout << "{\"tree\":{\"fanout\":" << options_.tree.fanout << ",\"depth\":" << options_.tree.depth
+                  << ",\"files_per_dir\":" << options_.tree.files_per_dir << ",\"sizes\":\"" << options_.tree.sizes
+                  << "\",\"seed\":" << options_.tree.seed << ",\"directories\":" << tree.directories
+                  << ",\"files\":" << tree.files << ",\"bytes\":" << tree.bytes << "}}" << std::endl;
+
+        if (selected("parseSizeString")) {
+            benchParseSizeString();
+        }
+        if (selected("formatFileSize")) {
+            benchFormatFileSize();
+        }
+        if (selected("getCurrentFileSize")) {
+            benchGetCurrentFileSize(scan_root);
+        }
+        if (selected("calculateDirectorySize")) {
+            benchCalculateDirectorySize(scan_root, tree);
+        }
+        if (selected("loadConfig")) {
+            benchLoadConfig(scan_root);
+        }
+        if (selected("emptyDirectory")) {
+            benchEmptyDirectory();
+        }
+        if (selected("trash")) {
+            benchTrash();
+        }
+
+        if (!options_.keep) {
+            std::filesystem::remove_all(options_.root, ec);
+        }
+        FileSizeMonitor::flushLog();
+        return 0;
+    }
+
+    // Create the tree depth-first in name order, so the random sizes follow the same sequence every time
+    static TreeStats generateTree(const std::filesystem::path& root, const TreeSpec& spec) {
+        TreeStats stats;
+        std::mt19937_64 random(spec.seed);
+        SizeDistribution distribution(spec.sizes);
+        generateLevel(root, spec, 0, random, distribution, stats);
+        return stats;
+    }
+
+    // Files and subdirectories below the root of a generated tree
+    static size_t treeEntries(const TreeSpec& spec) {
+        size_t directories = 0;
+        size_t level_width = 1;
+        for (size_t level = 0; level <= spec.depth; level++) {
+            directories += level_width;
+            level_width *= spec.fanout;
+        }
+        return directories - 1 + directories * spec.files_per_dir;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // File sizes drawn from the spec of TreeSpec::sizes; files are sparse, only their length is set
+    class SizeDistribution {
+    public:
+        explicit SizeDistribution(const std::string& spec) {
+            size_t colon = spec.find(':');
+            std::string kind = spec.substr(0, colon);
+            std::string args = colon == std::string::npos ? std::string() : spec.substr(colon + 1);
+            if (kind == "fixed") {
+                kind_ = Kind::Fixed;
+                a_ = FileSizeMonitor::parseSizeString(args);
+            } else if (kind == "uniform") {
+                kind_ = Kind::Uniform;
+                size_t dash = args.find('-');
+                a_ = FileSizeMonitor::parseSizeString(args.substr(0, dash));
+                b_ = dash == std::string::npos ? a_ : FileSizeMonitor::parseSizeString(args.substr(dash + 1));
+            } else {
+                if (kind != "lognormal") {
+                    std::cerr << "Warning: Unknown size distribution '" << spec << "', using lognormal:10,2" << std::endl;
+                    args = "10,2";
+                }
+                kind_ = Kind::LogNormal;
+                size_t comma = args.find(',');
+                a_ = std::atof(args.c_str());
+                b_ = comma == std::string::npos ? 1.0 : std::atof(args.c_str() + comma + 1);
+            }
+        }
+
+        uintmax_t operator()(std::mt19937_64& random) const {
+            switch (kind_) {
+            case Kind::Fixed:
+                return static_cast<uintmax_t>(a_);
+            case Kind::Uniform:
+                return static_cast<uintmax_t>(std::uniform_real_distribution<double>(a_, std::max(a_, b_))(random));
+            case Kind::LogNormal:
+                // Capped at 64 GB so a long tail cannot exceed what sparse files support
+                return static_cast<uintmax_t>(std::min(std::lognormal_distribution<double>(a_, b_)(random), 64.0 * (1ull << 30)));
+            }
+            return 0;
+        }
+
+    private:
+        enum class Kind {
+            Fixed,
+            Uniform,
+            LogNormal
+        };
+
+        Kind kind_ = Kind::LogNormal;
+        double a_ = 0;
+        double b_ = 0;
+    };
+
+    struct Sample {
+        std::string benchmark;
+        std::string variant;
+        size_t items = 0;             // Work done by one iteration (entries, calls, lines)
+        std::vector<double> seconds;  // One per iteration
+    };
+
+    Options options_;
+    volatile double sink_ = 0; // Keeps results of pure functions alive
+
+    bool selected(const std::string& name) const {
+        return options_.only.empty() || options_.only.count(name) > 0;
+    }
+
+    static void generateLevel(const std::filesystem::path& dir, const TreeSpec& spec, size_t level,
+                              std::mt19937_64& random, const SizeDistribution& distribution, TreeStats& stats) {
+        std::filesystem::create_directories(dir);
+        stats.directories++;
+        for (size_t i = 0; i < spec.files_per_dir; i++) {
+            uintmax_t size = distribution(random);
+            std::filesystem::path file = dir / ("f" + std::to_string(i));
+            std::ofstream(file, std::ios::binary | std::ios::trunc).close();
+            std::error_code ec;
+            std::filesystem::resize_file(file, size, ec);
+            if (!ec) {
+                stats.bytes += size;
+            }
+            stats.files++;
+        }
+        if (level < spec.depth) {
+            for (size_t i = 0; i < spec.fanout; i++) {
+                generateLevel(dir / ("d" + std::to_string(i)), spec, level + 1, random, distribution, stats);
+            }
+        }
+    }
+
+    // Time iterations of body; setup runs untimed before each one
+    template <typename Setup, typename Body>
+    Sample measure(const std::string& benchmark, const std::string& variant, size_t items, Setup setup, Body body) {
+        Sample sample{benchmark, variant, items, {}};
+        for (size_t i = 0; i < options_.repeat; i++) {
+            setup();
+            auto start = Clock::now();
+            body();
+            sample.seconds.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+        }
+        report(sample);
+        return sample;
+    }
+
+    template <typename Body>
+    Sample measure(const std::string& benchmark, const std::string& variant, size_t items, Body body) {
+        return measure(benchmark, variant, items, [] {}, body);
+    }
+
+    static void report(const Sample& sample) {
+        std::vector<double> sorted = sample.seconds;
+        std::sort(sorted.begin(), sorted.end());
+        double mean = 0;
+        for (double seconds : sorted) {
+            mean += seconds;
+        }
+        mean /= static_cast<double>(std::max<size_t>(1, sorted.size()));
+        double median = sorted.empty() ? 0 : sorted[sorted.size() / 2];
+
+        std::string line = "{\"benchmark\":\"" + sample.benchmark + "\",\"variant\":\"" + sample.variant + "\",\"iterations\":";
+        FileSizeMonitor::LogLine::appendNumber(line, sorted.size());
+        line += ",\"items\":";
+        FileSizeMonitor::LogLine::appendNumber(line, sample.items);
+        line += ",\"min_s\":";
+        FileSizeMonitor::LogLine::appendNumber(line, sorted.empty() ? 0.0 : sorted.front());
+        line += ",\"median_s\":";
+        FileSizeMonitor::LogLine::appendNumber(line, median);
+        line += ",\"mean_s\":";
+        FileSizeMonitor::LogLine::appendNumber(line, mean);
+        line += ",\"max_s\":";
+        FileSizeMonitor::LogLine::appendNumber(line, sorted.empty() ? 0.0 : sorted.back());
+        line += ",\"items_per_second\":";
+        FileSizeMonitor::LogLine::appendNumber(line, median > 0 ? static_cast<double>(sample.items) / median : 0.0);
+        line += "}";
+        std::cout << line << std::endl;
+    }
+
+    struct ChurnEntry {
+        std::filesystem::path path;
+        std::mutex mutex;
+        uint64_t generation = 0;       // Bumped whenever the monitor trashes the entry
+        double bytes = 0;              // Size as the writers know it
+        bool crossed = false;
+        Clock::time_point crossed_at;
+        size_t crossings = 0;
+        std::deque<Clock::time_point> detected; // Detections waiting for their reclaim
+    };
+
+    struct ChurnTotals {
+        std::mutex mutex;
+        double bytes_written = 0;
+        double writer_cpu_seconds = 0;
+        size_t detections = 0;
+        size_t detections_without_crossing = 0;
+        std::vector<double> detect_latencies;
+        std::vector<double> free_latencies;
+    };
+
+    static double cpuSeconds(bool thread_only) {
+        #ifndef _WIN32
+        if (thread_only) {
+            timespec ts{};
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+            return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+        }
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+               static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+        #else
+        (void)thread_only;
+        return 0;
+        #endif
+    }
+
+    static std::string latencyJson(std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        auto at = [&values](double q) {
+            return values.empty() ? 0.0 : values[std::min(values.size() - 1, static_cast<size_t>(q * static_cast<double>(values.size())))];
+        };
+        std::string json = "{\"count\":";
+        FileSizeMonitor::LogLine::appendNumber(json, values.size());
+        json += ",\"p50\":";
+        FileSizeMonitor::LogLine::appendNumber(json, at(0.5));
+        json += ",\"p90\":";
+        FileSizeMonitor::LogLine::appendNumber(json, at(0.9));
+        json += ",\"p99\":";
+        FileSizeMonitor::LogLine::appendNumber(json, at(0.99));
+        json += ",\"max\":";
+        FileSizeMonitor::LogLine::appendNumber(json, values.empty() ? 0.0 : values.back());
+        json += "}";
+        return json;
+    }
+
+    // One writer: round-robin over its entries, growing a file of its own or creating one (now and
+    // then in a new subdirectory), paced to the configured rate. Files are sparse, so only the
+    // metadata work of the monitor is measured, not disk bandwidth.
+    void churnWriter(size_t self, std::vector<std::unique_ptr<ChurnEntry>>& entries, double rate, double step, double limit,
+                     const std::atomic<bool>& stop, ChurnTotals& totals) {
+        struct Local {
+            uint64_t generation = UINT64_MAX;
+            std::vector<std::pair<std::filesystem::path, uintmax_t>> files;
+            std::filesystem::path dir;
+            size_t new_files = 0;
+            size_t subdirs = 0;
+        };
+        const ChurnOptions& churn = options_.churn;
+        std::vector<Local> local(entries.size());
+        std::mt19937_64 random(options_.tree.seed * 31 + self);
+        size_t next = self % entries.size();
+        auto start = Clock::now();
+        double written = 0;
+
+        while (!stop.load()) {
+            auto due = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(written / rate));
+            auto now = Clock::now();
+            if (due > now) {
+                std::this_thread::sleep_until(std::min(due, now + std::chrono::milliseconds(100)));
+                continue;
+            }
+
+            ChurnEntry& entry = *entries[next];
+            Local& mine = local[next];
+            next = (next + std::max<size_t>(1, churn.writers)) % entries.size();
+            uint64_t generation;
+            {
+                std::lock_guard<std::mutex> lock(entry.mutex);
+                generation = entry.generation;
+            }
+            if (mine.generation != generation) {
+                // Trashed: the entry starts over empty
+                mine = Local();
+                mine.generation = generation;
+            }
+
+            std::error_code ec;
+            if (mine.files.empty() || random() % 4 == 0) {
+                if (mine.new_files % std::max<size_t>(1, churn.files_per_subdir) == 0) {
+                    mine.dir = entry.path / ("w" + std::to_string(self) + "_" + std::to_string(mine.subdirs++));
+                    std::filesystem::create_directories(mine.dir, ec);
+                }
+                std::filesystem::path file = mine.dir / ("f" + std::to_string(mine.new_files++));
+                std::ofstream(file, std::ios::binary | std::ios::trunc).close();
+                std::filesystem::resize_file(file, static_cast<uintmax_t>(step), ec);
+                mine.files.emplace_back(file, static_cast<uintmax_t>(step));
+            } else {
+                auto& [file, size] = mine.files[random() % mine.files.size()];
+                size += static_cast<uintmax_t>(step);
+                std::filesystem::resize_file(file, size, ec);
+            }
+            written += step;
+
+            std::lock_guard<std::mutex> lock(entry.mutex);
+            if (!ec && entry.generation == generation) {
+                entry.bytes += step;
+                if (!entry.crossed && entry.bytes >= limit) {
+                    entry.crossed = true;
+                    entry.crossed_at = Clock::now();
+                    entry.crossings++;
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(totals.mutex);
+        totals.bytes_written += written;
+        totals.writer_cpu_seconds += cpuSeconds(true);
+    }
+
+    // Run the monitor against writers and report detection latency (threshold crossing to the trash
+    // action), time to free the space (to the end of the background reclaim), CPU and I/O per detection
+    int runChurn() {
+        const ChurnOptions& churn = options_.churn;
+        double rate = FileSizeMonitor::parseSizeString(churn.rate);
+        double step = FileSizeMonitor::parseSizeString(churn.step);
+        double limit = FileSizeMonitor::parseSizeString(churn.limit);
+        if (rate <= 0 || step <= 0 || limit <= 0 || churn.entries == 0 || churn.writers == 0) {
+            std::cerr << "Invalid churn settings" << std::endl;
+            return 2;
+        }
+
+        TreeSpec seed_tree = options_.tree;
+        if (!options_.custom_tree) {
+            seed_tree = TreeSpec{2, 2, 8, "uniform:1KB-64KB", options_.tree.seed};
+        }
+
+        std::filesystem::path churn_root = options_.root / "churn";
+        std::error_code ec;
+        std::filesystem::remove_all(churn_root, ec);
+        std::filesystem::path tsv = options_.root / "churn.tsv";
+        std::vector<std::unique_ptr<ChurnEntry>> entries;
+        std::unordered_map<std::string, size_t> by_path;
+        {
+            std::ofstream out(tsv, std::ios::binary | std::ios::trunc);
+            out << "file\tsize\texecute\ttype\n";
+            for (size_t i = 0; i < churn.entries; i++) {
+                auto entry = std::make_unique<ChurnEntry>();
+                entry->path = churn_root / ("e" + std::to_string(i));
+                TreeSpec spec = seed_tree;
+                spec.seed += i;
+                entry->bytes = static_cast<double>(generateTree(entry->path, spec).bytes);
+                if (entry->bytes >= limit) {
+                    std::cerr << "Warning: Entry " << entry->path.string() << " starts above its limit" << std::endl;
+                }
+                out << entry->path.string() << '\t' << churn.limit << "\ttrash\tpath\n";
+                by_path[entry->path.string()] = i;
+                entries.push_back(std::move(entry));
+            }
+        }
+
+        FileSizeMonitor monitor;
+        if (!monitor.loadConfig(tsv.string())) {
+            return 1;
+        }
+        monitor.setAdaptiveScheduling(churn.adaptive, 1, 300);
+
+        ChurnTotals totals;
+        FileSizeMonitor::bench_on_oversize = [&](const std::string& path) {
+            auto found = by_path.find(path);
+            if (found == by_path.end()) {
+                return;
+            }
+            ChurnEntry& entry = *entries[found->second];
+            auto now = Clock::now();
+            std::scoped_lock lock(entry.mutex, totals.mutex);
+            totals.detections++;
+            if (entry.crossed) {
+                totals.detect_latencies.push_back(std::chrono::duration<double>(now - entry.crossed_at).count());
+            } else {
+                totals.detections_without_crossing++;
+            }
+            entry.crossed = false;
+            entry.bytes = 0;
+            entry.generation++;
+            entry.detected.push_back(now);
+        };
+        FileSizeMonitor::bench_on_reclaimed = [&](const std::filesystem::path& victim) {
+            // Victims are named <entry>.<stamp>.<sequence>
+            std::string name = victim.filename().string();
+            auto found = by_path.find((churn_root / name.substr(0, name.find('.'))).string());
+            if (found == by_path.end()) {
+                return;
+            }
+            ChurnEntry& entry = *entries[found->second];
+            auto now = Clock::now();
+            std::scoped_lock lock(entry.mutex, totals.mutex);
+            if (!entry.detected.empty()) {
+                totals.free_latencies.push_back(std::chrono::duration<double>(now - entry.detected.front()).count());
+                entry.detected.pop_front();
+            }
+        };
+
+        uint64_t stat_calls = FileSizeMonitor::metrics().statCalls();
+        uint64_t dir_reads = FileSizeMonitor::metrics().dirReads();
+        #ifdef FSM_ENABLE_STATS
+        auto stats_before = std::make_unique<FileSizeMonitor::HotStats::Snapshot>();
+        FileSizeMonitor::HotStats::snapshot(*stats_before);
+        #endif
+        double cpu_before = cpuSeconds(false);
+        auto started = Clock::now();
+
+        std::thread monitor_thread([&monitor, &churn] { monitor.startMonitoring(churn.interval); });
+        std::atomic<bool> stop_writers{false};
+        std::vector<std::thread> writers;
+        for (size_t i = 0; i < churn.writers; i++) {
+            writers.emplace_back([&, i] { churnWriter(i, entries, rate, step, limit, stop_writers, totals); });
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(churn.seconds));
+        stop_writers.store(true);
+        for (auto& writer : writers) {
+            writer.join();
+        }
+
+        // Give the monitor time to catch the last crossings and the reclaims to finish
+        auto grace_end = Clock::now() + std::chrono::seconds(2 * churn.interval + 2);
+        auto settled = [&entries] {
+            for (const auto& entry : entries) {
+                std::lock_guard<std::mutex> lock(entry->mutex);
+                if (entry->crossed || !entry->detected.empty()) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        while (Clock::now() < grace_end && !settled()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        monitor.stopMonitoring();
+        monitor_thread.join();
+        auto drain_end = Clock::now() + std::chrono::seconds(30);
+        while (FileSizeMonitor::trashQueue().pendingJobs() > 0 && Clock::now() < drain_end) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        double elapsed = std::chrono::duration<double>(Clock::now() - started).count();
+        double monitor_cpu = cpuSeconds(false) - cpu_before - totals.writer_cpu_seconds;
+        FileSizeMonitor::bench_on_oversize = nullptr;
+        FileSizeMonitor::bench_on_reclaimed = nullptr;
+
+        size_t crossings = 0;
+        size_t missed = 0;
+        for (const auto& entry : entries) {
+            crossings += entry->crossings;
+            missed += entry->crossed ? 1 : 0;
+        }
+        double per_detection = 1.0 / static_cast<double>(std::max<size_t>(1, totals.detections));
+
+        std::string line = "{\"churn\":{\"entries\":";
+        FileSizeMonitor::LogLine::appendNumber(line, churn.entries);
+        line += ",\"writers\":";
+        FileSizeMonitor::LogLine::appendNumber(line, churn.writers);
+        line += ",\"rate_bytes_per_second\":";
+        FileSizeMonitor::LogLine::appendNumber(line, rate);
+        line += ",\"step_bytes\":";
+        FileSizeMonitor::LogLine::appendNumber(line, step);
+        line += ",\"limit_bytes\":";
+        FileSizeMonitor::LogLine::appendNumber(line, limit);
+        line += ",\"interval_s\":";
+        FileSizeMonitor::LogLine::appendNumber(line, churn.interval);
+        line += ",\"adaptive\":";
+        line += churn.adaptive ? "true" : "false";
+        line += ",\"backend\":\"";
+        line += backendName(FileSizeMonitor::effectiveScanBackend());
+        line += "\",\"seconds\":";
+        FileSizeMonitor::LogLine::appendNumber(line, churn.seconds);
+        line += "},\"elapsed_s\":";
+        FileSizeMonitor::LogLine::appendNumber(line, elapsed);
+        line += ",\"bytes_written\":";
+        FileSizeMonitor::LogLine::appendNumber(line, totals.bytes_written);
+        line += ",\"crossings\":";
+        FileSizeMonitor::LogLine::appendNumber(line, crossings);
+        line += ",\"detections\":";
+        FileSizeMonitor::LogLine::appendNumber(line, totals.detections);
+        line += ",\"detections_without_crossing\":";
+        FileSizeMonitor::LogLine::appendNumber(line, totals.detections_without_crossing);
+        line += ",\"missed\":";
+        FileSizeMonitor::LogLine::appendNumber(line, missed);
+        line += ",\"detect_latency_s\":" + latencyJson(totals.detect_latencies);
+        line += ",\"free_latency_s\":" + latencyJson(totals.free_latencies);
+        line += ",\"monitor_cpu_s\":";
+        FileSizeMonitor::LogLine::appendNumber(line, monitor_cpu);
+        line += ",\"stat_calls_per_detection\":";
+        FileSizeMonitor::LogLine::appendNumber(line, static_cast<double>(FileSizeMonitor::metrics().statCalls() - stat_calls) * per_detection);
+        line += ",\"dir_reads_per_detection\":";
+        FileSizeMonitor::LogLine::appendNumber(line, static_cast<double>(FileSizeMonitor::metrics().dirReads() - dir_reads) * per_detection);
+        #ifdef FSM_ENABLE_STATS
+        auto stats_after = std::make_unique<FileSizeMonitor::HotStats::Snapshot>();
+        FileSizeMonitor::HotStats::snapshot(*stats_after);
+        line += ",\"deletions_per_detection\":";
+        FileSizeMonitor::LogLine::appendNumber(line, static_cast<double>(stats_after->counters[FileSizeMonitor::HotStats::Deletions] -
+                                                                         stats_before->counters[FileSizeMonitor::HotStats::Deletions]) * per_detection);
+        #endif
+        line += "}";
+        std::cout << line << std::endl;
+        return 0;
+    }
+
+    static const char* backendName(FileSizeMonitor::ScanBackend backend) {
+        switch (backend) {
+        case FileSizeMonitor::ScanBackend::Filesystem:
+            return "std";
+        case FileSizeMonitor::ScanBackend::Raw:
+            return "raw";
+        case FileSizeMonitor::ScanBackend::Uring:
+            return "uring";
+        default:
+            return "auto";
+        }
+    }
+
+    // Backends a walk or a tree deletion can use on this build
+    static std::vector<std::pair<std::string, FileSizeMonitor::ScanBackend>> backends() {
+        std::vector<std::pair<std::string, FileSizeMonitor::ScanBackend>> result{{"std", FileSizeMonitor::ScanBackend::Filesystem}};
+        #ifdef __linux__
+        result.emplace_back("raw", FileSizeMonitor::ScanBackend::Raw);
+        #endif
+        #ifdef FSM_IO_URING_BACKEND
+        if (FileSizeMonitor::IoUringBatch::supported()) {
+            result.emplace_back("uring", FileSizeMonitor::ScanBackend::Uring);
+        }
+        #endif
+        return result;
+    }
+
+    void benchParseSizeString() {
+        const std::vector<std::string> inputs{"500TB", "100MB", "1.5GB", "12kb", "7B", "3g", "250Mb", "0.5T"};
+        constexpr size_t ROUNDS = 100000;
+        measure("parseSizeString", "", ROUNDS * inputs.size(), [&] {
+            double total = 0;
+            for (size_t round = 0; round < ROUNDS; round++) {
+                for (const std::string& input : inputs) {
+                    total += FileSizeMonitor::parseSizeString(input);
+                }
+            }
+            sink_ = total;
+        });
+    }
+
+    void benchFormatFileSize() {
+        constexpr size_t CALLS = 1000000;
+        measure("formatFileSize", "", CALLS, [&] {
+            size_t length = 0;
+            double value = 1;
+            for (size_t i = 0; i < CALLS; i++) {
+                length += FileSizeMonitor::formatFileSize(value).size();
+                value = value * 1.37 + 1;
+                if (value > 1e15) {
+                    value = 1;
+                }
+            }
+            sink_ = static_cast<double>(length);
+        });
+    }
+
+    void benchGetCurrentFileSize(const std::filesystem::path& scan_root) {
+        std::vector<std::string> files;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(scan_root)) {
+            if (entry.is_regular_file()) {
+                files.push_back(entry.path().string());
+                if (files.size() == 10000) {
+                    break;
+                }
+            }
+        }
+        measure("getCurrentFileSize", "", files.size(), [&] {
+            double total = 0;
+            for (const std::string& file : files) {
+                total += FileSizeMonitor::getCurrentFileSize(file);
+            }
+            sink_ = total;
+        });
+    }
+
+    void benchCalculateDirectorySize(const std::filesystem::path& scan_root, const TreeStats& tree) {
+        size_t entries = tree.directories - 1 + tree.files; // Same as treeEntries(), but counted
+        size_t default_threads = FileSizeMonitor::effectiveScanThreads();
+        std::vector<size_t> thread_counts{1};
+        if (default_threads > 1) {
+            thread_counts.push_back(default_threads);
+        }
+        for (const auto& [name, backend] : backends()) {
+            FileSizeMonitor::setScanBackend(backend);
+            for (size_t threads : thread_counts) {
+                FileSizeMonitor::setScanThreads(static_cast<int>(threads));
+                measure("calculateDirectorySize", name + "/" + std::to_string(threads) + "t", entries, [&] {
+                    auto result = FileSizeMonitor::calculateDirectorySize(scan_root.string());
+                    sink_ = static_cast<double>(result.total_size);
+                });
+            }
+        }
+        FileSizeMonitor::setScanBackend(FileSizeMonitor::ScanBackend::Auto);
+        FileSizeMonitor::setScanThreads(0);
+    }
+
+    void benchLoadConfig(const std::filesystem::path& scan_root) {
+        std::filesystem::path tsv = options_.root / "bench.tsv";
+        {
+            std::ofstream out(tsv, std::ios::binary | std::ios::trunc);
+            out << "file\tsize\texecute\ttype\tinterval\n";
+            const char* sizes[] = {"500MB", "1.5GB", "100KB", "2TB"};
+            for (size_t i = 0; i < options_.config_entries; i++) {
+                bool path = i % 3 == 0;
+                out << (scan_root / ("entry" + std::to_string(i))).string() << '\t' << sizes[i % 4] << '\t'
+                    << (i % 5 == 0 ? "trash" : "warn") << '\t' << (path ? "path" : "file") << '\t'
+                    << (i % 2 == 0 ? "30s" : "") << '\n';
+            }
+        }
+        measure("loadConfig", "", options_.config_entries, [&] {
+            FileSizeMonitor monitor;
+            monitor.loadConfig(tsv.string());
+        });
+    }
+
+    // In-process deletion of a whole tree, the path taken when the graveyard rename is not possible
+    void benchEmptyDirectory() {
+        std::filesystem::path target = options_.root / "delete" / "tree";
+        for (const auto& [name, backend] : backends()) {
+            #ifdef __linux__
+            if (backend == FileSizeMonitor::ScanBackend::Filesystem) {
+                continue; // The tree deleter only tells raw and io_uring apart
+            }
+            #endif
+            FileSizeMonitor::setScanBackend(backend);
+            measure("emptyDirectory", name, treeEntries(options_.tree), [&] {
+                std::error_code ec;
+                std::filesystem::remove_all(target, ec);
+                generateTree(target, options_.tree);
+            }, [&] {
+                FileSizeMonitor::emptyDirectory(target.string());
+            });
+        }
+        FileSizeMonitor::setScanBackend(FileSizeMonitor::ScanBackend::Auto);
+    }
+
+    // The trash action: rename into the graveyard, then the background reclaim, timed until it is done
+    void benchTrash() {
+        std::filesystem::path target = options_.root / "delete" / "tree";
+        std::vector<double> renames;
+        measure("trash", "total", treeEntries(options_.tree), [&] {
+            std::error_code ec;
+            std::filesystem::remove_all(target, ec);
+            generateTree(target, options_.tree);
+        }, [&] {
+            auto start = Clock::now();
+            FileSizeMonitor::trashDirectory(target.string(), FileSizeMonitor::DeletionPace());
+            renames.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+            while (FileSizeMonitor::trashQueue().pendingJobs() > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+        report(Sample{"trash", "rename", treeEntries(options_.tree), renames});
+    }
+};
+
+int main(int argc, char* argv[]) {
+    FileSizeMonitorBenchmark::Options options;
+    options.root = std::filesystem::temp_directory_path() / ("fsm-bench-" + std::to_string(
+        std::chrono::steady_clock::now().time_since_epoch().count()));
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--root" && i + 1 < argc) {
+            options.root = argv[++i];
+        } else if (arg == "--fanout" && i + 1 < argc) {
+            options.tree.fanout = static_cast<size_t>(std::atoll(argv[++i]));
+            options.custom_tree = true;
+        } else if (arg == "--depth" && i + 1 < argc) {
+            options.tree.depth = static_cast<size_t>(std::atoll(argv[++i]));
+            options.custom_tree = true;
+        } else if (arg == "--files" && i + 1 < argc) {
+            options.tree.files_per_dir = static_cast<size_t>(std::atoll(argv[++i]));
+            options.custom_tree = true;
+        } else if (arg == "--sizes" && i + 1 < argc) {
+            options.tree.sizes = argv[++i];
+            options.custom_tree = true;
+        } else if (arg == "--seed" && i + 1 < argc) {
+            options.tree.seed = static_cast<uint64_t>(std::atoll(argv[++i]));
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            options.repeat = std::max<size_t>(1, static_cast<size_t>(std::atoll(argv[++i])));
+        } else if (arg == "--config-entries" && i + 1 < argc) {
+            options.config_entries = static_cast<size_t>(std::atoll(argv[++i]));
+        } else if (arg == "--only" && i + 1 < argc) {
+            std::istringstream names(argv[++i]);
+            std::string name;
+            while (std::getline(names, name, ',')) {
+                options.only.insert(name);
+            }
+        } else if (arg == "--keep") {
+            options.keep = true;
+        } else if (arg == "--churn") {
+            options.churn.enabled = true;
+        } else if (arg == "--entries" && i + 1 < argc) {
+            options.churn.entries = static_cast<size_t>(std::atoll(argv[++i]));
+        } else if (arg == "--writers" && i + 1 < argc) {
+            options.churn.writers = static_cast<size_t>(std::atoll(argv[++i]));
+        } else if (arg == "--rate" && i + 1 < argc) {
+            options.churn.rate = argv[++i];
+        } else if (arg == "--step" && i + 1 < argc) {
+            options.churn.step = argv[++i];
+        } else if (arg == "--limit" && i + 1 < argc) {
+            options.churn.limit = argv[++i];
+        } else if (arg == "--files-per-subdir" && i + 1 < argc) {
+            options.churn.files_per_subdir = static_cast<size_t>(std::atoll(argv[++i]));
+        } else if (arg == "--duration" && i + 1 < argc) {
+            options.churn.seconds = std::atof(argv[++i]);
+        } else if (arg == "--interval" && i + 1 < argc) {
+            options.churn.interval = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--adaptive") {
+            options.churn.adaptive = true;
+        } else if (arg == "--scan-backend" && i + 1 < argc) {
+            std::string backend = argv[++i];
+            FileSizeMonitor::setScanBackend(backend == "std" ? FileSizeMonitor::ScanBackend::Filesystem
+                                            : backend == "raw" ? FileSizeMonitor::ScanBackend::Raw
+                                            : backend == "uring" ? FileSizeMonitor::ScanBackend::Uring
+                                                                 : FileSizeMonitor::ScanBackend::Auto);
+        } else {
+            std::cerr << "Usage: FileSizeMgrBench [--root DIR] [--fanout N] [--depth N] [--files N] [--sizes SPEC]\n"
+                         "                        [--seed N] [--repeat N] [--config-entries N] [--only NAME,...] [--keep]\n"
+                         "       FileSizeMgrBench --churn [--entries N] [--writers N] [--rate SIZE] [--step SIZE] [--limit SIZE]\n"
+                         "                        [--files-per-subdir N] [--duration S] [--interval S] [--adaptive]\n"
+                         "                        [--scan-backend auto|std|raw|uring] [tree options] [--root DIR] [--keep]" << std::endl;
+            return 2;
+        }
+    }
+
+    FileSizeMonitor::setLogLevel(FileSizeMonitor::LogLevel::Warning);
+    return FileSizeMonitorBenchmark(options).run();
+}
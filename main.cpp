@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <filesystem>
 #include <thread>
 #include <chrono>
@@ -13,12 +14,746 @@
 #include <locale>
 #include <codecvt>
 
+#include <set>
+#include <functional>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <random>
+#include <charconv>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <csignal>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+#if defined(FSM_HAVE_LIBURING) || defined(FSM_HAVE_IO_URING)
+#define FSM_IO_URING_BACKEND
+#endif
+
+// Hot-path counters and phase timers; without FSM_ENABLE_STATS they expand to nothing
+#ifdef FSM_ENABLE_STATS
+#include <bit>
+#define FSM_STAT_ADD(counter, amount) HotStats::add(HotStats::counter, amount)
+#define FSM_STAT_SCOPE(phase) HotStats::Scope stat_scope(HotStats::phase)
+#else
+#define FSM_STAT_ADD(counter, amount) ((void)0)
+#define FSM_STAT_SCOPE(phase) ((void)0)
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/vfs.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <climits>
+#ifdef FSM_HAVE_LIBURING
+#include <liburing.h>
+#elif defined(FSM_HAVE_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#endif
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+#ifdef FSM_BENCHMARK
+class FileSizeMonitorBenchmark;
 #endif
 
 class FileSizeMonitor {
+public:
+    class DirectorySizeTree;
+#ifdef FSM_BENCHMARK
+    friend class FileSizeMonitorBenchmark;
+#endif
+
+    enum class LogLevel {
+        Debug,
+        Info,
+        Warning,
+        Error
+    };
+
 private:
+    // Asynchronous logger: callers format a line and push it into a bounded lock-free MPSC ring, a
+    // background writer drains it in batches with one write per batch. When the ring is full the line
+    // is dropped and counted instead of blocking the caller.
+    class Logger {
+    public:
+        static constexpr size_t CAPACITY = 1 << 14; // Power of two
+
+        Logger() : slots_(CAPACITY) {
+            for (size_t i = 0; i < CAPACITY; i++) {
+                slots_[i].sequence.store(i, std::memory_order_relaxed);
+            }
+            writer_ = std::thread([this] { writerLoop(); });
+        }
+
+        ~Logger() {
+            stop_.store(true);
+            wake_.notify_one();
+            writer_.join();
+        }
+
+        Logger(const Logger&) = delete;
+        Logger& operator=(const Logger&) = delete;
+
+        bool enabled(LogLevel level) const {
+            return level >= min_level_.load(std::memory_order_relaxed);
+        }
+
+        void setLevel(LogLevel level) {
+            min_level_.store(level);
+        }
+
+        void push(LogLevel level, std::string&& text) {
+            size_t position = tail_.load(std::memory_order_relaxed);
+            while (true) {
+                Slot& slot = slots_[position & (CAPACITY - 1)];
+                size_t sequence = slot.sequence.load(std::memory_order_acquire);
+                auto distance = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+                if (distance == 0) {
+                    if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        slot.level = level;
+                        slot.text = std::move(text);
+                        slot.sequence.store(position + 1, std::memory_order_release);
+                        break;
+                    }
+                } else if (distance < 0) {
+                    // The writer is a full ring behind
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                } else {
+                    position = tail_.load(std::memory_order_relaxed);
+                }
+            }
+            if (idle_.load(std::memory_order_relaxed)) {
+                wake_.notify_one();
+            }
+        }
+
+        // Wait until everything pushed so far is written, e.g. before prompting on the console
+        void flush() {
+            size_t target = tail_.load(std::memory_order_acquire);
+            while (written_.load(std::memory_order_acquire) < target) {
+                wake_.notify_one();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+    private:
+        struct Slot {
+            std::atomic<size_t> sequence{0};
+            LogLevel level = LogLevel::Info;
+            std::string text;
+        };
+
+        std::vector<Slot> slots_;
+        alignas(64) std::atomic<size_t> tail_{0};
+        alignas(64) size_t head_ = 0; // Only touched by the writer
+        std::atomic<size_t> written_{0};
+        std::atomic<size_t> dropped_{0};
+        std::atomic<LogLevel> min_level_{LogLevel::Info};
+        std::atomic<bool> stop_{false};
+        std::atomic<bool> idle_{false};
+        std::mutex wake_mutex_;
+        std::condition_variable wake_;
+        std::thread writer_;
+
+        void writerLoop() {
+            std::string out;
+            std::string err;
+            while (true) {
+                out.clear();
+                err.clear();
+                while (true) {
+                    Slot& slot = slots_[head_ & (CAPACITY - 1)];
+                    if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) {
+                        break;
+                    }
+                    std::string& target = slot.level >= LogLevel::Warning ? err : out;
+                    target += slot.text;
+                    target += '\n';
+                    slot.text.clear();
+                    slot.sequence.store(head_ + CAPACITY, std::memory_order_release);
+                    head_++;
+                }
+                size_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+                if (dropped > 0) {
+                    err += "Warning: " + std::to_string(dropped) + " log messages dropped\n";
+                }
+
+                if (!out.empty()) {
+                    std::fwrite(out.data(), 1, out.size(), stdout);
+                    std::fflush(stdout);
+                }
+                if (!err.empty()) {
+                    std::fwrite(err.data(), 1, err.size(), stderr);
+                    std::fflush(stderr);
+                }
+                written_.store(head_, std::memory_order_release);
+
+                if (out.empty() && err.empty()) {
+                    if (stop_.load() && tail_.load(std::memory_order_acquire) == head_) {
+                        return;
+                    }
+                    // Producers only notify while the writer is idle; the timeout covers a missed wakeup
+                    std::unique_lock<std::mutex> lock(wake_mutex_);
+                    idle_.store(true);
+                    wake_.wait_for(lock, std::chrono::milliseconds(20));
+                    idle_.store(false);
+                }
+            }
+        }
+    };
+
+    static Logger& logger() {
+        static Logger instance;
+        return instance;
+    }
+
+    // One log line, built with << and handed to the logger when the statement ends
+    class LogLine {
+    public:
+        explicit LogLine(LogLevel level) : level_(level), enabled_(logger().enabled(level)) {}
+
+        ~LogLine() {
+            if (enabled_) {
+                logger().push(level_, std::move(text_));
+            }
+        }
+
+        LogLine(const LogLine&) = delete;
+        LogLine& operator=(const LogLine&) = delete;
+
+        LogLine& operator<<(const std::string& value) {
+            if (enabled_) {
+                text_ += value;
+            }
+            return *this;
+        }
+
+        LogLine& operator<<(const char* value) {
+            if (enabled_) {
+                text_ += value;
+            }
+            return *this;
+        }
+
+        LogLine& operator<<(char value) {
+            if (enabled_) {
+                text_ += value;
+            }
+            return *this;
+        }
+
+        template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+        LogLine& operator<<(T value) {
+            if (enabled_) {
+                appendNumber(text_, value);
+            }
+            return *this;
+        }
+
+        template <typename T>
+        static void appendNumber(std::string& text, T value) {
+            char buffer[32];
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+            text.append(buffer, result.ptr);
+        }
+
+    private:
+        LogLevel level_;
+        bool enabled_;
+        std::string text_;
+    };
+
+    static LogLine logDebug() {
+        return LogLine(LogLevel::Debug);
+    }
+
+    static LogLine logInfo() {
+        return LogLine(LogLevel::Info);
+    }
+
+    static LogLine logWarning() {
+        return LogLine(LogLevel::Warning);
+    }
+
+    static LogLine logError() {
+        return LogLine(LogLevel::Error);
+    }
+
+    // Fixed-point number with the given number of decimals, without going through a stream
+    static std::string formatFixed(double value, int precision) {
+        char buffer[64];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, precision);
+        return std::string(buffer, result.ptr);
+    }
+
+#ifdef FSM_ENABLE_STATS
+    // Per-thread hot-path counters and latency histograms. Every thread owns a block and is its only
+    // writer, so an update is a relaxed load and store; a report sums all blocks without locking.
+    class HotStats {
+    public:
+        enum Counter {
+            DirectoriesOpened,
+            EntriesRead,
+            StatCalls,
+            BytesAccounted,
+            Errors,
+            Deletions,
+            COUNTER_COUNT
+        };
+
+        enum Phase {
+            Directory,  // Listing one directory in a walker
+            Probe,      // Size probe of a FILE entry
+            Entry,      // Measuring one entry
+            Action,     // Handling an oversized entry
+            Round,      // One scheduler round of due entries
+            PHASE_COUNT
+        };
+
+        // Log-linear buckets over nanoseconds: 8 sub-buckets per power of two, within 12.5%
+        static constexpr unsigned SUB_BUCKET_BITS = 3;
+        static constexpr size_t BUCKETS = 64 << SUB_BUCKET_BITS;
+
+        struct Snapshot {
+            std::array<uint64_t, COUNTER_COUNT> counters{};
+            std::array<std::array<uint64_t, BUCKETS>, PHASE_COUNT> histograms{};
+        };
+
+        static void add(Counter counter, uint64_t amount) {
+            std::atomic<uint64_t>& value = local().counters[counter];
+            value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+
+        static void record(Phase phase, uint64_t nanoseconds) {
+            std::atomic<uint64_t>& value = local().histograms[phase][bucketIndex(nanoseconds)];
+            value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        // Times the enclosing scope into a phase histogram
+        class Scope {
+        public:
+            explicit Scope(Phase phase) : phase_(phase), start_(std::chrono::steady_clock::now()) {}
+
+            ~Scope() {
+                auto elapsed = std::chrono::steady_clock::now() - start_;
+                record(phase_, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+            }
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            Phase phase_;
+            std::chrono::steady_clock::time_point start_;
+        };
+
+        static void snapshot(Snapshot& out) {
+            out = Snapshot{};
+            for (Block* block = head_.load(std::memory_order_acquire); block; block = block->next) {
+                for (size_t i = 0; i < COUNTER_COUNT; i++) {
+                    out.counters[i] += block->counters[i].load(std::memory_order_relaxed);
+                }
+                for (size_t phase = 0; phase < PHASE_COUNT; phase++) {
+                    for (size_t i = 0; i < BUCKETS; i++) {
+                        out.histograms[phase][i] += block->histograms[phase][i].load(std::memory_order_relaxed);
+                    }
+                }
+            }
+        }
+
+        // Upper end of the bucket holding the given quantile, 0 without samples
+        static uint64_t quantile(const std::array<uint64_t, BUCKETS>& histogram, double q) {
+            uint64_t total = 0;
+            for (uint64_t count : histogram) {
+                total += count;
+            }
+            if (total == 0) {
+                return 0;
+            }
+            uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * static_cast<double>(total) + 0.5));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKETS; i++) {
+                seen += histogram[i];
+                if (seen >= rank) {
+                    return bucketLimit(i);
+                }
+            }
+            return bucketLimit(BUCKETS - 1);
+        }
+
+    private:
+        struct Block {
+            std::array<std::atomic<uint64_t>, COUNTER_COUNT> counters{};
+            std::array<std::array<std::atomic<uint64_t>, BUCKETS>, PHASE_COUNT> histograms{};
+            std::atomic<bool> owned{true};
+            Block* next = nullptr;
+        };
+
+        // Blocks are never freed: an exiting thread releases its block to the next new thread,
+        // so the list is bounded by the peak number of threads and its counts stay cumulative
+        struct Owner {
+            Block* block = claim();
+
+            ~Owner() {
+                block->owned.store(false, std::memory_order_release);
+            }
+        };
+
+        static inline std::atomic<Block*> head_{nullptr};
+
+        static Block& local() {
+            thread_local Owner owner;
+            return *owner.block;
+        }
+
+        static Block* claim() {
+            for (Block* block = head_.load(std::memory_order_acquire); block; block = block->next) {
+                bool expected = false;
+                if (!block->owned.load(std::memory_order_relaxed) &&
+                    block->owned.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                    return block;
+                }
+            }
+            Block* block = new Block();
+            block->next = head_.load(std::memory_order_relaxed);
+            while (!head_.compare_exchange_weak(block->next, block, std::memory_order_release, std::memory_order_relaxed)) {
+            }
+            return block;
+        }
+
+        static size_t bucketIndex(uint64_t value) {
+            if (value < (1u << SUB_BUCKET_BITS)) {
+                return static_cast<size_t>(value);
+            }
+            unsigned exponent = 63 - static_cast<unsigned>(std::countl_zero(value));
+            uint64_t sub = (value >> (exponent - SUB_BUCKET_BITS)) & ((1u << SUB_BUCKET_BITS) - 1);
+            return (static_cast<size_t>(exponent - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) + static_cast<size_t>(sub);
+        }
+
+        static uint64_t bucketLimit(size_t index) {
+            if (index < (1u << SUB_BUCKET_BITS)) {
+                return index;
+            }
+            unsigned shift = static_cast<unsigned>(index >> SUB_BUCKET_BITS) - 1;
+            uint64_t sub = (1u << SUB_BUCKET_BITS) + (index & ((1u << SUB_BUCKET_BITS) - 1));
+            return ((sub + 1) << shift) - 1;
+        }
+    };
+#endif
+
+    // Append a string as a JSON string literal
+    static void appendJsonString(std::string& out, const std::string& value) {
+        out += '"';
+        for (unsigned char c : value) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += static_cast<char>(c);
+            } else if (c < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += static_cast<char>(c);
+            }
+        }
+        out += '"';
+    }
+
+    // Timeline of scoped phases for Chrome trace-event JSON (loads in Perfetto and chrome://tracing).
+    // Each thread records into its own buffer and hands full buffers over in chunks, so recording
+    // takes no lock per event; a disabled tracer costs one relaxed load per scope.
+    class Tracer {
+    public:
+        static constexpr size_t CHUNK_EVENTS = 4096;
+        static constexpr size_t MAX_EVENTS = 1 << 21;
+
+        static bool enabled() {
+            return enabled_.load(std::memory_order_relaxed);
+        }
+
+        static void enable() {
+            epoch_ = std::chrono::steady_clock::now();
+            enabled_.store(true);
+        }
+
+        // Label the calling thread in the timeline
+        static void nameThread(const char* name) {
+            if (enabled()) {
+                local().name = name;
+            }
+        }
+
+        class Scope {
+        public:
+            explicit Scope(const char* name) : active_(enabled()), name_(name) {
+                if (active_) {
+                    start_ = std::chrono::steady_clock::now();
+                }
+            }
+
+            Scope(const char* name, const std::string& detail) : Scope(name) {
+                if (active_) {
+                    detail_ = detail;
+                }
+            }
+
+            Scope(const char* name, const std::filesystem::path& detail) : Scope(name) {
+                if (active_) {
+                    detail_ = detail.string();
+                }
+            }
+
+            ~Scope() {
+                if (active_) {
+                    record(name_, std::move(detail_), start_, std::chrono::steady_clock::now());
+                }
+            }
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            bool active_;
+            const char* name_;
+            std::string detail_;
+            std::chrono::steady_clock::time_point start_;
+        };
+
+        // Write everything recorded so far; events of threads still running are included once they
+        // filled a chunk or exited
+        static bool write(const std::string& path) {
+            if (!enabled()) {
+                return true;
+            }
+            local().handOver();
+            std::vector<Chunk> chunks;
+            {
+                std::lock_guard<std::mutex> lock(chunks_mutex_);
+                chunks = chunks_;
+            }
+
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                logError() << "Error: Cannot write trace file " << path;
+                return false;
+            }
+            std::string text = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+            std::set<uint32_t> named;
+            bool first = true;
+            for (const Chunk& chunk : chunks) {
+                if (named.insert(chunk.tid).second) {
+                    text += first ? "" : ",\n";
+                    first = false;
+                    text += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":";
+                    LogLine::appendNumber(text, chunk.tid);
+                    text += ",\"args\":{\"name\":";
+                    appendJsonString(text, std::string(chunk.name) + " " + std::to_string(chunk.tid));
+                    text += "}}";
+                }
+                for (const Event& event : chunk.events) {
+                    text += first ? "" : ",\n";
+                    first = false;
+                    text += "{\"name\":\"";
+                    text += event.name;
+                    text += "\",\"cat\":\"fsm\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+                    LogLine::appendNumber(text, chunk.tid);
+                    text += ",\"ts\":";
+                    appendMicroseconds(text, event.begin_ns);
+                    text += ",\"dur\":";
+                    appendMicroseconds(text, event.duration_ns);
+                    if (!event.detail.empty()) {
+                        text += ",\"args\":{\"path\":";
+                        appendJsonString(text, event.detail);
+                        text += "}";
+                    }
+                    text += "}";
+                }
+                if (text.size() > (1 << 20)) {
+                    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+                    text.clear();
+                }
+            }
+            text += "\n]}\n";
+            out.write(text.data(), static_cast<std::streamsize>(text.size()));
+            if (!out) {
+                logError() << "Error: Cannot write trace file " << path;
+                return false;
+            }
+            logInfo() << "Wrote trace of " << recorded_.load() << " events to " << path;
+            if (dropped_.load() > 0) {
+                logWarning() << "Warning: Trace limit reached, " << dropped_.load() << " events were not recorded";
+            }
+            return true;
+        }
+
+    private:
+        struct Event {
+            const char* name;
+            std::string detail;
+            int64_t begin_ns;
+            int64_t duration_ns;
+        };
+
+        struct Chunk {
+            uint32_t tid;
+            const char* name;
+            std::vector<Event> events;
+        };
+
+        // Per-thread buffer, handed over when full and when the thread exits
+        struct Buffer {
+            uint32_t tid = next_tid_.fetch_add(1);
+            const char* name = "thread";
+            std::vector<Event> events;
+
+            ~Buffer() {
+                handOver();
+            }
+
+            void handOver() {
+                if (events.empty()) {
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(chunks_mutex_);
+                chunks_.push_back(Chunk{tid, name, std::move(events)});
+                events.clear();
+            }
+        };
+
+        static inline std::atomic<bool> enabled_{false};
+        static inline std::chrono::steady_clock::time_point epoch_;
+        static inline std::atomic<uint32_t> next_tid_{1};
+        static inline std::atomic<size_t> recorded_{0};
+        static inline std::atomic<size_t> dropped_{0};
+        static inline std::mutex chunks_mutex_;
+        static inline std::vector<Chunk> chunks_;
+
+        static Buffer& local() {
+            thread_local Buffer buffer;
+            return buffer;
+        }
+
+        static void record(const char* name, std::string detail, std::chrono::steady_clock::time_point start,
+                           std::chrono::steady_clock::time_point end) {
+            if (recorded_.fetch_add(1, std::memory_order_relaxed) >= MAX_EVENTS) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            Buffer& buffer = local();
+            buffer.events.push_back(Event{name, std::move(detail),
+                                          std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch_).count(),
+                                          std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()});
+            if (buffer.events.size() >= CHUNK_EVENTS) {
+                buffer.handOver();
+            }
+        }
+
+        static void appendMicroseconds(std::string& out, int64_t nanoseconds) {
+            LogLine::appendNumber(out, nanoseconds / 1000);
+            int64_t fraction = nanoseconds % 1000;
+            char digits[5] = {'.', static_cast<char>('0' + fraction / 100), static_cast<char>('0' + fraction / 10 % 10),
+                              static_cast<char>('0' + fraction % 10), '\0'};
+            out += digits;
+        }
+    };
+
+    // Optional throttling of the deletions done for one entry (TSV column "pace")
+    struct DeletionPace {
+        double unlinks_per_second = 0;   // 0 = unlimited
+        double bytes_per_second = 0;     // 0 = unlimited, counted as allocated blocks freed
+        bool idle_io = false;            // Run deletion threads in the idle I/O scheduling class
+        double catchup_free_ratio = 0.05; // Below this share of free space the limits are relaxed
+
+        bool paced() const {
+            return unlinks_per_second > 0 || bytes_per_second > 0;
+        }
+
+        bool operator==(const DeletionPace& other) const = default;
+    };
+
+    // Budget of the scanner: stat calls and directory reads per second, scaled down under I/O pressure
+    struct ScanBudget {
+        double stats_per_second = 0; // 0 = unlimited
+        double dirs_per_second = 0;  // 0 = unlimited, counted per directory read call
+        double psi_threshold = 0;    // Back off while io "some" avg10 pressure exceeds this percentage, 0 = off
+        bool idle_io = false;        // Run scanning threads in the idle I/O scheduling class
+
+        bool governed() const {
+            return stats_per_second > 0 || dirs_per_second > 0 || psi_threshold > 0;
+        }
+    };
+
+    // State of an entry as seen by the event output
+    enum class EntryState {
+        Unknown,
+        Ok,
+        Exceeded,
+        Missing,
+        TimedOut
+    };
+
+    // Result slot of one size measurement, shared with the worker so one stuck on a hung mount can finish late
+    struct Measurement {
+        std::atomic<bool> done{false};
+        double size = -1;
+        size_t file_count = 0;
+        size_t folder_count = 0;
+        double seconds = 0; // Time the measurement took
+        bool unvalidated = false; // Partly from a scan index whose validation is still in progress
+    };
+
+    // Health of one device: repeated scan timeouts mark it degraded, then it is probed with backoff
+    struct MountHealth {
+        size_t timeouts = 0;
+        bool degraded = false;
+        int backoff_seconds = 0;
+        std::chrono::steady_clock::time_point retry_at{};
+        std::shared_ptr<Measurement> probe; // Background scan probing a degraded device
+        std::chrono::steady_clock::time_point probe_started{};
+        std::vector<std::shared_ptr<Measurement>> abandoned_probes; // Hung probes replaced by a retry, still running
+    };
+    static constexpr size_t TIMEOUTS_BEFORE_DEGRADED = 3;
+    static constexpr size_t MAX_ABANDONED_PROBES = 4; // Per device; beyond this no new probe thread is started
+    static constexpr int MAX_BACKOFF_SECONDS = 900;
+
+    // Per-entry check timing, driven by the observed growth rate
+    struct CheckSchedule {
+        double last_size = -1;
+        std::chrono::steady_clock::time_point last_check{};
+        double growth_rate = 0; // Bytes per second, smoothed
+        bool has_rate = false;
+        bool scheduled = false;
+    };
+
     struct FileConfig {
         std::string path;
         double max_size_bytes;
@@ -26,10 +761,199 @@ private:
         std::string action;
         bool has_warned;
         std::string type; // Add type field to indicate the item type (file or path)
+        std::shared_ptr<DirectorySizeTree> size_tree; // Incrementally maintained totals of a PATH entry
+        bool validate_tree = false;  // No events feed the tree, so every measurement validates it first
+        DeletionPace pace;
+        double low_watermark_bytes = 0;  // evict: delete oldest files until the size is below this
+        bool evict_by_atime = false;     // evict: order by access time instead of modification time
+        std::shared_ptr<std::atomic<bool>> evicting = std::make_shared<std::atomic<bool>>(false);
+        CheckSchedule schedule;
+        int interval_seconds = 0; // 0 uses the monitor interval
+        uint64_t device = 0;      // st_dev of the path, groups checks per device
+        size_t device_limit = 1;  // Checks allowed in flight on that device
+        bool device_known = false;
+        std::shared_ptr<Measurement> measuring; // Set while a measurement may still be running
+        EntryState reported_state = EntryState::Unknown; // Last state sent as an event
+        double reported_size = -1;
+    };
+
+    // Upper bound of files an eviction pass keeps in memory
+    static constexpr size_t EVICTION_CANDIDATES = 8192;
+
+    // Column positions of the TSV, taken from the header line
+    struct ColumnLayout {
+        int file = 0;
+        int size = 1;
+        int execute = 2;
+        int type = 3;
+        int pace = -1;
+        int low = -1;
+        int evict_by = -1;
+        int interval = -1;
+    };
+
+    // Identifies one version of the TSV, so a change is noticed without reading the file
+    struct ConfigSignature {
+        bool exists = false;
+        int64_t mtime = 0;
+        uintmax_t size = 0;
+
+        bool operator==(const ConfigSignature& other) const {
+            return exists == other.exists && mtime == other.mtime && size == other.size;
+        }
+    };
+
+    // Marks an entry that a reload removed when indices are renumbered
+    static constexpr size_t NO_ENTRY = SIZE_MAX;
+
+    // Hierarchical timer wheel with one-second ticks. Scheduling and cancelling are O(1), a timer moves
+    // down at most once per level as its deadline approaches. Cancelled timers are dropped lazily.
+    class TimerWheel {
+    public:
+        static constexpr int LEVELS = 4;
+        static constexpr int SLOT_BITS = 6;
+        static constexpr uint64_t SLOTS = 1ull << SLOT_BITS;
+        static constexpr uint64_t HORIZON = 1ull << (SLOT_BITS * LEVELS); // About 194 days
+
+        // (Re)schedule a timer for id, replacing any pending one
+        void schedule(size_t id, uint64_t delay_ticks) {
+            if (id >= generations_.size()) {
+                generations_.resize(id + 1, 0);
+            }
+            delay_ticks = std::clamp<uint64_t>(delay_ticks, 1, HORIZON - 1);
+            insert({id, ++generations_[id], now_ + delay_ticks});
+        }
+
+        void cancel(size_t id) {
+            if (id < generations_.size()) {
+                ++generations_[id];
+            }
+        }
+
+        uint64_t now() const {
+            return now_;
+        }
+
+        // Move pending timers to the ids given by new_ids[old id]; timers of NO_ENTRY ids are dropped
+        void renumber(const std::vector<size_t>& new_ids, size_t id_count) {
+            std::vector<uint64_t> generations(id_count, 0);
+            for (auto& level : slots_) {
+                for (auto& slot : level) {
+                    std::vector<Timer> kept;
+                    for (const Timer& timer : slot) {
+                        if (timer.id < new_ids.size() && new_ids[timer.id] != NO_ENTRY && timer.generation == generations_[timer.id]) {
+                            size_t id = new_ids[timer.id];
+                            kept.push_back({id, ++generations[id], timer.expires});
+                        }
+                    }
+                    slot.swap(kept);
+                }
+            }
+            generations_.swap(generations);
+        }
+
+        // Advance to the given tick and call due(id) for every timer that expired on the way
+        template <typename Due>
+        void advance(uint64_t tick, Due due) {
+            while (now_ < tick) {
+                now_++;
+                // Cascade from the coarsest level that wrapped, so its timers can land in the finer slots
+                int wrapped = 0;
+                while (wrapped + 1 < LEVELS && (now_ & ((1ull << (SLOT_BITS * (wrapped + 1))) - 1)) == 0) {
+                    wrapped++;
+                }
+                for (int level = wrapped; level > 0; level--) {
+                    std::vector<Timer> timers;
+                    timers.swap(slots_[level][(now_ >> (SLOT_BITS * level)) & (SLOTS - 1)]);
+                    for (const Timer& timer : timers) {
+                        if (timer.generation == generations_[timer.id]) {
+                            insert(timer);
+                        }
+                    }
+                }
+
+                std::vector<Timer> expired;
+                expired.swap(slots_[0][now_ & (SLOTS - 1)]);
+                for (const Timer& timer : expired) {
+                    if (timer.generation == generations_[timer.id]) {
+                        ++generations_[timer.id];
+                        due(timer.id);
+                    }
+                }
+            }
+        }
+
+    private:
+        struct Timer {
+            size_t id;
+            uint64_t generation;
+            uint64_t expires;
+        };
+
+        uint64_t now_ = 0;
+        std::vector<uint64_t> generations_;
+        std::vector<Timer> slots_[LEVELS][SLOTS];
+
+        void insert(const Timer& timer) {
+            uint64_t delta = timer.expires - now_;
+            int level = 0;
+            while (level + 1 < LEVELS && delta >= (1ull << (SLOT_BITS * (level + 1)))) {
+                level++;
+            }
+            slots_[level][(timer.expires >> (SLOT_BITS * level)) & (SLOTS - 1)].push_back(timer);
+        }
     };
 
     std::vector<FileConfig> file_configs;
-    bool running = false;
+    std::string config_path;
+    ConfigSignature config_signature;   // Of the configuration in use
+    ConfigSignature pending_signature;  // A change is applied once the file stayed the same for one poll
+    std::deque<size_t> warmup_entries;  // Added by a reload, measured a few at a time between rounds
+    std::set<size_t> deferred_entries;  // Put off by a timeout, a stuck scan, a degraded device or an unfinished index validation; due on the timer even if event-driven
+    std::atomic<bool> running{false};
+    int check_interval_seconds = 5;
+    bool adaptive_scheduling = false;
+    int min_interval_seconds = 1;
+    int max_interval_seconds = 300;
+    static inline size_t check_threads = 0;
+    static inline int scan_timeout_seconds = 60;
+    std::unordered_map<uint64_t, MountHealth> mount_health;
+    TimerWheel check_timers;
+    std::chrono::steady_clock::time_point timer_epoch = std::chrono::steady_clock::now();
+    std::mt19937 jitter_random{std::random_device{}()};
+    static inline size_t scan_threads = 0; // Directory walk threads, 0 = automatic
+    static inline size_t delete_threads = 0; // Tree deletion threads, 0 = same as scan threads
+
+public:
+    // How directory walks read the file system
+    enum class ScanBackend {
+        Auto,       // Best backend available on this platform
+        Filesystem, // std::filesystem, portable
+        Raw,        // getdents64 + statx relative to the directory fd (Linux)
+        Uring       // Raw, with the statx calls of each directory batched through io_uring
+    };
+
+private:
+    static inline ScanBackend scan_backend = ScanBackend::Auto;
+    static inline bool scan_idle_io = false;
+    static inline bool trust_dir_mtime = false; // Unchanged directories are not listed again during validation
+
+#ifdef __linux__
+    // One inotify watch can serve several entries (nested paths, files sharing a directory)
+    struct WatchInfo {
+        std::string dir_path;
+        std::vector<size_t> path_owners;                         // PATH entries whose subtree contains this directory
+        std::vector<std::pair<size_t, std::string>> file_owners; // FILE entries located directly in this directory
+    };
+
+    static constexpr uint32_t WATCH_MASK = IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                           IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK;
+
+    int inotify_fd = -1;
+    std::unordered_map<int, WatchInfo> watches;
+    std::vector<bool> polled_entries;  // Entries without usable watches, re-checked every interval
+    std::set<size_t> rewatch_entries;  // Entries whose watched directories were removed or replaced
+#endif
 
 public:
     // Convert UTF-8 string to wide string (for Windows)
@@ -63,34 +987,27 @@ public:
         #endif
     }
 
-    // Parse size string
-    static double parseSizeString(const std::string& size_str) {
+    // Parse size string; line_num, when known, goes into the warnings
+    static double parseSizeString(std::string_view size_str, int line_num = 0) {
         if (size_str.empty()) return 0.0;
 
-        std::string num_str = size_str;
-        std::string unit;
-
         // Separate number and unit
         size_t i = 0;
-        while (i < num_str.length() && (std::isdigit(num_str[i]) || num_str[i] == '.')) {
+        while (i < size_str.length() && (std::isdigit(static_cast<unsigned char>(size_str[i])) || size_str[i] == '.')) {
             i++;
         }
+        std::string_view num_str = size_str.substr(0, i);
+        std::string_view unit = size_str.substr(i);
 
-        if (i < num_str.length()) {
-            unit = num_str.substr(i);
-            num_str = num_str.substr(0, i);
-        }
-
-        double size_value;
-        try {
-            size_value = std::stod(num_str);
-        } catch (const std::exception& e) {
-            std::cerr << "Warning: Invalid size format '" << num_str << "', using 0 as default" << std::endl;
+        double size_value = 0;
+        auto parsed = std::from_chars(num_str.data(), num_str.data() + num_str.size(), size_value);
+        if (parsed.ec != std::errc()) {
+            logWarning() << "Warning: Invalid size format '" << std::string(num_str) << "'" << lineSuffix(line_num) << ", using 0 as default";
             return 0.0;
         }
 
         // Convert to lowercase for comparison
-        std::string unit_lower = unit;
+        std::string unit_lower(unit);
         std::transform(unit_lower.begin(), unit_lower.end(), unit_lower.begin(), ::tolower);
 
         // Convert based on unit
@@ -105,434 +1022,5016 @@ public:
         } else if (unit_lower == "t" || unit_lower == "tb") {
             return size_value * 1024.0 * 1024.0 * 1024.0 * 1024.0;
         } else {
-            std::cerr << "Warning: Unknown unit '" << unit << "', using bytes as default" << std::endl;
+            logWarning() << "Warning: Unknown unit '" << std::string(unit) << "'" << lineSuffix(line_num) << ", using bytes as default";
             return size_value;
         }
     }
 
+    static std::string lineSuffix(int line_num) {
+        return line_num > 0 ? " in line " + std::to_string(line_num) : std::string();
+    }
+
     // Parse action
-    static std::string parseAction(const std::string& action_str) {
-        std::string action_lower = action_str;
+    static std::string parseAction(std::string_view action_str, int line_num = 0) {
+        std::string action_lower(action_str);
         std::transform(action_lower.begin(), action_lower.end(), action_lower.begin(), ::tolower);
 
-        if (action_lower == "warn" || action_lower == "trash") {
+        if (action_lower == "warn" || action_lower == "trash" || action_lower == "evict") {
             return action_lower;
         } else {
-            std::cerr << "Warning: Unknown action '" << action_str << "', using 'warn' as default" << std::endl;
+            logWarning() << "Warning: Unknown action '" << std::string(action_str) << "'" << lineSuffix(line_num) << ", using 'warn' as default";
             return "warn";
         }
     }
 
+    // Map header names to column positions; a header without the known names keeps the classic layout
+    static ColumnLayout parseHeader(const std::vector<std::string>& names) {
+        ColumnLayout layout{-1, -1, -1, -1, -1, -1, -1, -1};
+        for (int i = 0; i < static_cast<int>(names.size()); i++) {
+            std::string name = names[i];
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            if (name == "file") {
+                layout.file = i;
+            } else if (name == "size") {
+                layout.size = i;
+            } else if (name == "execute") {
+                layout.execute = i;
+            } else if (name == "type") {
+                layout.type = i;
+            } else if (name == "pace") {
+                layout.pace = i;
+            } else if (name == "low") {
+                layout.low = i;
+            } else if (name == "evict_by") {
+                layout.evict_by = i;
+            } else if (name == "interval") {
+                layout.interval = i;
+            } else {
+                logWarning() << "Warning: Unknown column '" << names[i] << "' in header, ignoring it";
+            }
+        }
+        if (layout.file < 0 || layout.size < 0 || layout.execute < 0) {
+            logWarning() << "Warning: Header does not name the file/size/execute columns, using the default column order";
+            return ColumnLayout{};
+        }
+        return layout;
+    }
+
+    // Parse a pace specification such as "unlinks=2000,bytes=100MB,io=idle,catchup=5%"
+    static DeletionPace parseDeletionPace(std::string_view pace_str, int line_num) {
+        DeletionPace pace;
+        if (pace_str.empty() || pace_str == "-") {
+            return pace;
+        }
+
+        std::string key;
+        std::string_view value;
+        while (!pace_str.empty()) {
+            std::string_view item = nextSetting(pace_str, key, value);
+            if (key == "unlinks") {
+                pace.unlinks_per_second = std::max(0.0, settingNumber(value));
+            } else if (key == "bytes") {
+                pace.bytes_per_second = parseSizeString(value, line_num);
+            } else if (key == "io") {
+                pace.idle_io = value == "idle";
+            } else if (key == "catchup") {
+                pace.catchup_free_ratio = std::clamp(settingNumber(value) / 100.0, 0.0, 1.0);
+            } else {
+                logWarning() << "Warning: Unknown pace setting '" << std::string(item) << "' in line " << line_num << ", ignoring it";
+            }
+        }
+        return pace;
+    }
+
+    // Parse a low watermark: a percentage of the threshold ("80%") or a size; defaults to 80% of the threshold
+    static double parseLowWatermark(const std::string& low_str, double max_bytes) {
+        if (low_str.empty()) {
+            return max_bytes * 0.8;
+        }
+        if (low_str.back() == '%') {
+            return max_bytes * std::clamp(std::atof(low_str.c_str()) / 100.0, 0.0, 1.0);
+        }
+        return std::min(parseSizeString(low_str), max_bytes);
+    }
+
+    // Parse a check interval such as "30", "30s", "5m", "2h" or "1d" into seconds; 0 when empty or invalid
+    static int parseInterval(const std::string& interval_str, int line_num) {
+        if (interval_str.empty() || interval_str == "-") {
+            return 0;
+        }
+        size_t unit_pos = interval_str.find_first_not_of("0123456789");
+        long long value = unit_pos == 0 ? 0 : std::atoll(interval_str.substr(0, unit_pos).c_str());
+        std::string unit = unit_pos == std::string::npos ? "s" : interval_str.substr(unit_pos);
+        std::transform(unit.begin(), unit.end(), unit.begin(), ::tolower);
+
+        long long multiplier = 0;
+        if (unit == "s") {
+            multiplier = 1;
+        } else if (unit == "m") {
+            multiplier = 60;
+        } else if (unit == "h") {
+            multiplier = 3600;
+        } else if (unit == "d") {
+            multiplier = 86400;
+        }
+        if (value <= 0 || multiplier == 0) {
+            logWarning() << "Warning: Invalid interval '" << interval_str << "' in line " << line_num << ", using the monitor interval";
+            return 0;
+        }
+        return static_cast<int>(std::min<long long>(value * multiplier, static_cast<long long>(TimerWheel::HORIZON - 1)));
+    }
+
+    static constexpr size_t LISTED_CONFIG_ENTRIES = 1000;
+
     // Read TSV file with encoding handling
     bool loadConfig(const std::string& tsv_path) {
-        // Open file in binary mode to handle encoding properly
-        std::ifstream file(tsv_path, std::ios::binary);
-        if (!file.is_open()) {
-            std::cerr << "Cannot open file: " << tsv_path << std::endl;
+        config_path = tsv_path;
+        config_signature = configSignature(tsv_path);
+        if (!parseConfig(tsv_path, file_configs)) {
+            return false;
+        }
+        // A generated configuration with a huge number of entries is only listed at debug level
+        LogLevel level = file_configs.size() <= LISTED_CONFIG_ENTRIES ? LogLevel::Info : LogLevel::Debug;
+        for (const auto& config : file_configs) {
+            LogLine(level) << "Loaded config: " << config.path << " -> " << config.original_size_str
+                      << " [" << config.action << "] (type: " << config.type << ", " << config.max_size_bytes << " bytes)";
+        }
+
+        logInfo() << "Successfully loaded " << file_configs.size() << " file configurations";
+        return !file_configs.empty();
+    }
+
+    // Read the TSV into configs; false if the file cannot be opened. The file is mapped and split in
+    // place; a large one is cut into chunks at line boundaries that are parsed in parallel.
+    static bool parseConfig(const std::string& tsv_path, std::vector<FileConfig>& configs) {
+        MappedFile file(tsv_path);
+        std::error_code ec;
+        if (!file.data() && (!std::filesystem::is_regular_file(tsv_path, ec) || std::filesystem::file_size(tsv_path, ec) != 0)) {
+            logError() << "Cannot open file: " << tsv_path;
             return false;
         }
+        std::string_view content(file.data(), file.size());
+
+        // Remove UTF-8 BOM if present
+        if (content.size() >= 3 && content.substr(0, 3) == "\xEF\xBB\xBF") {
+            content.remove_prefix(3);
+        }
+
+        // The first non-empty line (header) names the columns
+        ColumnLayout columns;
+        int line_num = 0;
+        std::vector<std::string_view> fields;
+        while (!content.empty()) {
+            std::string_view line = nextLine(content);
+            line_num++;
+            if (!line.empty()) {
+                splitFields(line, fields);
+                columns = parseHeader(std::vector<std::string>(fields.begin(), fields.end()));
+                break;
+            }
+        }
+
+        size_t chunk_count = std::clamp<size_t>(content.size() / PARSE_CHUNK_BYTES, 1,
+                                                std::max(1u, std::thread::hardware_concurrency()));
+        if (chunk_count == 1) {
+            parseConfigLines(content, line_num + 1, columns, configs);
+            return true;
+        }
+
+        struct Chunk {
+            std::string_view text;
+            int first_line;
+            std::vector<FileConfig> configs;
+        };
+        std::vector<Chunk> chunks;
+        size_t target = content.size() / chunk_count;
+        while (!content.empty()) {
+            size_t cut = content.size();
+            if (chunks.size() + 1 < chunk_count && target < content.size()) {
+                const char* newline = static_cast<const char*>(std::memchr(content.data() + target, '\n', content.size() - target));
+                cut = newline ? static_cast<size_t>(newline - content.data()) + 1 : content.size();
+            }
+            chunks.push_back({content.substr(0, cut), line_num + 1, {}});
+            line_num += static_cast<int>(std::count(content.begin(), content.begin() + cut, '\n'));
+            content.remove_prefix(cut);
+        }
+
+        std::vector<std::thread> threads;
+        for (Chunk& chunk : chunks) {
+            threads.emplace_back([&chunk, &columns] {
+                parseConfigLines(chunk.text, chunk.first_line, columns, chunk.configs);
+            });
+        }
+        size_t total = configs.size();
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+            total += chunks[i].configs.size();
+        }
+        configs.reserve(total);
+        for (Chunk& chunk : chunks) {
+            std::move(chunk.configs.begin(), chunk.configs.end(), std::back_inserter(configs));
+        }
+        return true;
+    }
+
+    // Below this many bytes per thread the TSV is parsed on the calling thread
+    static constexpr size_t PARSE_CHUNK_BYTES = 4 << 20;
+
+    // Cut the next line off text, without its line break
+    static std::string_view nextLine(std::string_view& text) {
+        const char* newline = static_cast<const char*>(std::memchr(text.data(), '\n', text.size()));
+        size_t length = newline ? static_cast<size_t>(newline - text.data()) : text.size();
+        std::string_view line = text.substr(0, length);
+        text.remove_prefix(newline ? length + 1 : length);
+        // Remove any carriage return characters (for Windows line endings)
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        return line;
+    }
+
+    // Split a line at tabs into fields trimmed of spaces; the views point into the line
+    static void splitFields(std::string_view line, std::vector<std::string_view>& fields) {
+        fields.clear();
+        while (true) {
+            const char* tab = static_cast<const char*>(std::memchr(line.data(), '\t', line.size()));
+            std::string_view field = line.substr(0, tab ? static_cast<size_t>(tab - line.data()) : line.size());
+            size_t first = field.find_first_not_of(' ');
+            field = first == std::string_view::npos ? std::string_view() : field.substr(first, field.find_last_not_of(' ') - first + 1);
+            fields.push_back(field);
+            if (!tab) {
+                break;
+            }
+            line.remove_prefix(static_cast<size_t>(tab - line.data()) + 1);
+        }
+        // A trailing tab does not start another field
+        if (fields.size() > 1 && line.empty()) {
+            fields.pop_back();
+        }
+    }
+
+    // Take the next item off a comma-separated "key=value" list; the key comes back lowercased
+    static std::string_view nextSetting(std::string_view& spec, std::string& key, std::string_view& value) {
+        size_t comma = spec.find(',');
+        std::string_view item = spec.substr(0, comma);
+        spec.remove_prefix(comma == std::string_view::npos ? spec.size() : comma + 1);
+        size_t equals = item.find('=');
+        key.assign(item.substr(0, equals));
+        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        value = equals == std::string_view::npos ? std::string_view() : item.substr(equals + 1);
+        return item;
+    }
+
+    // Leading number of a setting value, 0 when there is none
+    static double settingNumber(std::string_view value) {
+        double number = 0;
+        std::from_chars(value.data(), value.data() + value.size(), number);
+        return number;
+    }
+
+    // Parse the entry lines of text, the first of which is line first_line of the file
+    static void parseConfigLines(std::string_view text, int first_line, const ColumnLayout& columns, std::vector<FileConfig>& configs) {
+        int required = std::max({columns.file, columns.size, columns.execute}) + 1;
+        configs.reserve(configs.size() + static_cast<size_t>(std::count(text.begin(), text.end(), '\n')) + 1);
+        std::vector<std::string_view> fields;
+        int line_num = first_line - 1;
+        while (!text.empty()) {
+            std::string_view line = nextLine(text);
+            line_num++;
+
+            // Skip empty lines
+            if (line.empty()) {
+                continue;
+            }
+
+            // Parse TSV line format: fields separated by tabs
+            splitFields(line, fields);
+            if (static_cast<int>(fields.size()) < required) {
+                logWarning() << "Warning: Line " << line_num << " has incorrect format, skipping. Fields found: " << fields.size();
+                logWarning() << "Line content: " << std::string(line);
+                continue;
+            }
+
+            auto column = [&fields](int index) {
+                return index >= 0 && index < static_cast<int>(fields.size()) ? fields[index] : std::string_view();
+            };
+
+            std::string file_path(column(columns.file));
+            std::string_view size_str = column(columns.size);
+            std::string type = "file"; // Default type is file
+
+            // If there's a type column, read its value
+            if (!column(columns.type).empty()) {
+                type = std::string(column(columns.type));
+                // Convert to lowercase for comparison
+                std::transform(type.begin(), type.end(), type.begin(), ::tolower);
+                // Ensure type is either file or path
+                if (type != "file" && type != "path") {
+                    logWarning() << "Warning: Invalid type '" << type << "' in line " << line_num
+                                 << ", using 'file' as default";
+                    type = "file";
+                }
+            }
+
+            // Normalize file path - replace forward slashes with backslashes on Windows
+            #ifdef _WIN32
+            std::replace(file_path.begin(), file_path.end(), '/', '\\');
+            #endif
+
+            double max_bytes = parseSizeString(size_str, line_num);
+            std::string action = parseAction(column(columns.execute), line_num);
+
+            if (action == "evict" && type != "path") {
+                logWarning() << "Warning: 'evict' only applies to path entries, using 'warn' in line " << line_num;
+                action = "warn";
+            }
+
+            FileConfig& config = configs.emplace_back();
+            config.path = std::move(file_path);
+            config.max_size_bytes = max_bytes;
+            config.original_size_str = std::string(size_str);
+            config.action = std::move(action);
+            config.has_warned = false;
+            config.type = std::move(type);
+            config.pace = parseDeletionPace(column(columns.pace), line_num);
+            config.low_watermark_bytes = parseLowWatermark(std::string(column(columns.low)), max_bytes);
+            std::string evict_by(column(columns.evict_by));
+            std::transform(evict_by.begin(), evict_by.end(), evict_by.begin(), ::tolower);
+            config.evict_by_atime = evict_by == "atime";
+            if (!evict_by.empty() && evict_by != "atime" && evict_by != "mtime") {
+                logWarning() << "Warning: Invalid evict_by '" << evict_by << "' in line " << line_num << ", using 'mtime'";
+            }
+            config.interval_seconds = parseInterval(std::string(column(columns.interval)), line_num);
+        }
+    }
+
+    // Get current file size with proper encoding handling
+    static double getCurrentFileSize(const std::string& file_path) {
+        try {
+            #ifdef _WIN32
+            // On Windows, convert UTF-8 to wide string for filesystem operations
+            std::wstring wide_path = utf8_to_wide(file_path);
+            std::filesystem::path fs_path(wide_path);
+            #else
+            // On other systems, use the path directly
+            std::filesystem::path fs_path(file_path);
+            #endif
+
+            FSM_STAT_SCOPE(Probe);
+            scanGovernor().acquire(1, 0);
+            if (!std::filesystem::exists(fs_path)) {
+                logWarning() << "File does not exist: " << file_path;
+                return -1.0;
+            }
+
+            if (!std::filesystem::is_regular_file(fs_path)) {
+                logWarning() << "Path is not a regular file: " << file_path;
+                return -1.0;
+            }
+
+            uintmax_t size = std::filesystem::file_size(fs_path);
+            FSM_STAT_ADD(BytesAccounted, size);
+            return static_cast<double>(size);
+        } catch (const std::filesystem::filesystem_error& e) {
+            FSM_STAT_ADD(Errors, 1);
+            logError() << "Filesystem error for '" << file_path << "': " << e.what();
+            return -1.0;
+        } catch (const std::exception& e) {
+            logError() << "Error getting file size for '" << file_path << "': " << e.what();
+            return -1.0;
+        }
+    }
+
+    // Structure for directory size calculation results
+    struct DirectorySizeResult {
+        uintmax_t total_size;  // Total size in bytes
+        size_t file_count;     // Number of files
+        size_t folder_count;   // Number of subdirectories
+    };
+
+    // Per-directory hooks of a ParallelDirectoryWalker, called from its worker threads. A directory is only
+    // ever handed to one thread at a time; its tag is whatever the visitor set when its parent was visited.
+    class DirectoryVisitor {
+    public:
+        struct Directory {
+            std::filesystem::path path;
+            void* tag = nullptr;
+        };
+
+        virtual ~DirectoryVisitor() = default;
+
+        // Before a directory is read; returning false skips the listing and walks only what was put in subdirs
+        virtual bool enter(const Directory& dir, std::vector<Directory>& subdirs) = 0;
+
+        // After a directory was read: own holds its direct files and subdirectories, subdirs the ones that
+        // can be descended into (untagged). Whatever is left in subdirs is walked next.
+        virtual void listed(const Directory& dir, const DirectorySizeResult& own, std::vector<Directory>& subdirs) = 0;
+    };
+
+    class ScanIndex;
+
+    // In-memory size tree of one PATH entry: built once, then kept current per changed directory
+    class DirectorySizeTree {
+    public:
+        static constexpr size_t VALIDATION_SLICE_DIRS = 4096; // Directories per update() of a validation in slices
+
+        explicit DirectorySizeTree(std::string root_path) : root_path_(std::move(root_path)) {}
+
+        const std::string& rootPath() const {
+            return root_path_;
+        }
+
+        // Record a directory whose direct entries changed (thread-safe, applied by update())
+        void markDirty(const std::string& dir_path) {
+            std::lock_guard<std::mutex> lock(dirty_mutex_);
+            dirty_dirs_.insert(dir_path);
+        }
+
+        // Drop all state, the next update() walks the whole tree again
+        void invalidate() {
+            std::lock_guard<std::mutex> lock(dirty_mutex_);
+            needs_rebuild_ = true;
+            dirty_dirs_.clear();
+            validation_queue_.clear();
+        }
+
+        // Keep the state but have the next update() compare every directory with the disk
+        void revalidate() {
+            std::lock_guard<std::mutex> lock(dirty_mutex_);
+            needs_validation_ = true;
+            dirty_dirs_.clear();
+        }
+
+        // Like revalidate(), but spread over as many update() calls as it takes to compare VALIDATION_SLICE_DIRS
+        // directories each; until then the totals mix compared directories with the state the tree came with
+        void revalidateInSlices() {
+            std::lock_guard<std::mutex> lock(dirty_mutex_);
+            validation_queue_.assign(1, root_path_);
+        }
+
+        // A validation in slices has directories left to compare
+        bool validating() {
+            std::lock_guard<std::mutex> lock(dirty_mutex_);
+            return !validation_queue_.empty();
+        }
+
+        // Apply pending changes: a full build on first use, otherwise a re-list of each changed directory
+        void update() {
+            std::set<std::string> dirty;
+            std::vector<std::string> slice;
+            bool rebuild;
+            bool validation;
+            {
+                std::lock_guard<std::mutex> lock(dirty_mutex_);
+                dirty.swap(dirty_dirs_);
+                rebuild = needs_rebuild_ || !root_;
+                validation = needs_validation_;
+                needs_rebuild_ = false;
+                needs_validation_ = false;
+                // A build or a full validation leaves nothing to compare in slices
+                if (rebuild || validation) {
+                    validation_queue_.clear();
+                } else {
+                    slice.swap(validation_queue_);
+                }
+            }
+
+            if (rebuild) {
+                root_ = std::make_unique<Node>();
+                NodeLister lister(false);
+                walk(lister, {{root_path_, root_.get()}});
+                recomputeSubtree(root_.get());
+                return;
+            }
+            if (validation) {
+                validate();
+            } else if (!slice.empty()) {
+                validateSlice(slice);
+            }
+            if (!dirty.empty()) {
+                refreshDirectories(dirty);
+            }
+        }
+
+        // Totals of the whole tree, O(1) once update() has run
+        DirectorySizeResult totals() const {
+            if (!root_) {
+                return {0, 0, 0};
+            }
+            return {root_->total_size, root_->total_files, root_->total_folders};
+        }
+
+    private:
+        friend class ScanIndex;
+
+        // A directory counts as unchanged while its inode, mtime and ctime are
+        struct Identity {
+            uint64_t inode = 0;
+            int64_t mtime_ns = 0;
+            int64_t ctime_ns = 0;
+
+            bool operator==(const Identity& other) const {
+                return inode == other.inode && mtime_ns == other.mtime_ns && ctime_ns == other.ctime_ns;
+            }
+        };
+
+        struct Node {
+            std::string name;
+            Node* parent = nullptr;
+            Identity identity;          // As of the last listing
+            std::unordered_map<std::string, std::unique_ptr<Node>> children;
+            uintmax_t own_size = 0;     // Regular files directly inside this directory
+            size_t own_files = 0;
+            size_t own_folders = 0;     // Subdirectories directly inside (including unfollowed links)
+            uintmax_t total_size = 0;   // Whole subtree, own entries included
+            size_t total_files = 0;
+            size_t total_folders = 0;
+        };
+
+        std::string root_path_;
+        std::unique_ptr<Node> root_;
+        std::mutex dirty_mutex_;
+        std::set<std::string> dirty_dirs_;
+        bool needs_rebuild_ = true;
+        bool needs_validation_ = false;
+        std::vector<std::string> validation_queue_; // Directories a validation in slices has yet to compare
+
+        static bool readIdentity(const std::filesystem::path& dir_path, Identity& identity) {
+            #ifdef _WIN32
+            std::error_code ec;
+            auto mtime = std::filesystem::last_write_time(dir_path, ec);
+            if (ec || !std::filesystem::is_directory(dir_path, ec)) {
+                return false;
+            }
+            identity = Identity{0, static_cast<int64_t>(mtime.time_since_epoch().count()), 0};
+            return true;
+            #else
+            struct stat st{};
+            if (::stat(dir_path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+                return false;
+            }
+            identity.inode = static_cast<uint64_t>(st.st_ino);
+            identity.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+            identity.ctime_ns = static_cast<int64_t>(st.st_ctim.tv_sec) * 1000000000 + st.st_ctim.tv_nsec;
+            return true;
+            #endif
+        }
+
+        // Fills nodes from the listings of a ParallelDirectoryWalker, every directory tagged with its node.
+        // Known subdirectories are walked again only when validating; new ones are always built.
+        class NodeLister : public DirectoryVisitor {
+        public:
+            // A budget limits how many directories are entered; the ones beyond it are set aside
+            explicit NodeLister(bool validate, size_t budget = 0) : validate_(validate), budget_(budget) {}
+
+            bool enter(const Directory& dir, std::vector<Directory>& subdirs) override {
+                Node* node = static_cast<Node*>(dir.tag);
+                if (budget_ > 0 && entered_.fetch_add(1, std::memory_order_relaxed) >= budget_) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    set_aside_.push_back(dir.path.string());
+                    return false;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    visited_.push_back(node);
+                }
+                Identity current;
+                scanGovernor().acquire(1, 0);
+                if (!readIdentity(dir.path, current)) {
+                    // Gone since it was queued: count it as empty
+                    node->identity = Identity{};
+                    node->own_size = 0;
+                    node->own_files = 0;
+                    node->own_folders = 0;
+                    retire(node->children);
+                    return false;
+                }
+                if (validate_ && trust_dir_mtime && current == node->identity) {
+                    for (const auto& [name, child] : node->children) {
+                        subdirs.push_back({dir.path / name, child.get()});
+                    }
+                    return false;
+                }
+                // Taken before listing, so a change during the listing shows up as a change next time
+                node->identity = current;
+                return true;
+            }
+
+            void listed(const Directory& dir, const DirectorySizeResult& own, std::vector<Directory>& subdirs) override {
+                Node* node = static_cast<Node*>(dir.tag);
+                node->own_size = own.total_size;
+                node->own_files = own.file_count;
+                node->own_folders = own.folder_count;
+
+                std::unordered_map<std::string, std::unique_ptr<Node>> previous;
+                previous.swap(node->children);
+                size_t kept = 0;
+                for (size_t i = 0; i < subdirs.size(); i++) {
+                    std::string name = subdirs[i].path.filename().string();
+                    std::unique_ptr<Node> child;
+                    auto old = previous.find(name);
+                    bool known = old != previous.end();
+                    if (known) {
+                        child = std::move(old->second);
+                        previous.erase(old);
+                    } else {
+                        child = std::make_unique<Node>();
+                        child->name = name;
+                        child->parent = node;
+                    }
+                    if (!known || validate_) {
+                        subdirs[i].tag = child.get();
+                        if (kept != i) {
+                            subdirs[kept] = std::move(subdirs[i]);
+                        }
+                        kept++;
+                    }
+                    node->children.emplace(std::move(name), std::move(child));
+                }
+                subdirs.resize(kept);
+                retire(previous);
+            }
+
+            // Nodes entered during the walk
+            std::unordered_set<Node*> visitedNodes() const {
+                return std::unordered_set<Node*>(visited_.begin(), visited_.end());
+            }
+
+            // Directories left out because the budget ran out
+            std::vector<std::string>& setAside() {
+                return set_aside_;
+            }
+
+        private:
+            bool validate_;
+            size_t budget_;
+            std::atomic<size_t> entered_{0};
+            std::mutex mutex_;
+            std::vector<Node*> visited_;
+            std::vector<std::string> set_aside_;
+            // Dropped subtrees live until the walk is over: another walk root may still be inside one
+            std::vector<std::unique_ptr<Node>> retired_;
+
+            void retire(std::unordered_map<std::string, std::unique_ptr<Node>>& children) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (auto& [name, child] : children) {
+                    retired_.push_back(std::move(child));
+                }
+                children.clear();
+            }
+        };
+
+        // List directories through the parallel walker with the configured threads and backend
+        static void walk(NodeLister& lister, const std::vector<DirectoryVisitor::Directory>& roots) {
+            ParallelDirectoryWalker(effectiveScanThreads(), effectiveScanBackend()).walk(roots, lister);
+        }
+
+        // Compare every directory with the disk: changed ones are listed again, unchanged ones keep their
+        // subdirectories and are only listed again for their file sizes unless mtimes are trusted
+        void validate() {
+            NodeLister lister(true);
+            walk(lister, {{root_path_, root_.get()}});
+            recomputeSubtree(root_.get());
+        }
+
+        // Compare up to VALIDATION_SLICE_DIRS directories, starting where the last slice stopped
+        void validateSlice(const std::vector<std::string>& slice) {
+            std::vector<DirectoryVisitor::Directory> roots;
+            for (const auto& dir_path : slice) {
+                bool exact = false;
+                Node* node = findNode(dir_path, exact);
+                // Otherwise it is gone: the refresh of its changed parent dropped it
+                if (node && exact) {
+                    roots.push_back({dir_path, node});
+                }
+            }
+            NodeLister lister(true, VALIDATION_SLICE_DIRS);
+            walk(lister, roots);
+            applyWalk(roots, lister.visitedNodes());
+            // Unless a new build or validation was asked for meanwhile
+            std::lock_guard<std::mutex> lock(dirty_mutex_);
+            if (!needs_rebuild_ && !needs_validation_ && validation_queue_.empty()) {
+                validation_queue_.swap(lister.setAside());
+            }
+        }
+
+        // Recompute totals bottom-up below a node, descending only into the given nodes if any
+        static void recomputeSubtree(Node* top, const std::unordered_set<Node*>* only = nullptr) {
+            std::vector<Node*> order{top};
+            for (size_t i = 0; i < order.size(); i++) {
+                for (const auto& [name, child] : order[i]->children) {
+                    if (!only || only->count(child.get())) {
+                        order.push_back(child.get());
+                    }
+                }
+            }
+            for (auto it = order.rbegin(); it != order.rend(); ++it) {
+                recomputeTotals(*it);
+            }
+        }
+
+        static void recomputeTotals(Node* node) {
+            node->total_size = node->own_size;
+            node->total_files = node->own_files;
+            node->total_folders = node->own_folders;
+            for (const auto& [name, child] : node->children) {
+                node->total_size += child->total_size;
+                node->total_files += child->total_files;
+                node->total_folders += child->total_folders;
+            }
+        }
+
+        // Locate the node for a directory below the root, or the deepest existing ancestor
+        Node* findNode(const std::filesystem::path& dir_path, bool& exact) const {
+            exact = false;
+            if (!root_) {
+                return nullptr;
+            }
+            std::filesystem::path relative = dir_path.lexically_relative(root_path_);
+            if (relative.empty() || *relative.begin() == "..") {
+                return nullptr;
+            }
+            Node* node = root_.get();
+            for (const auto& part : relative) {
+                if (part == ".") {
+                    continue;
+                }
+                auto it = node->children.find(part.string());
+                if (it == node->children.end()) {
+                    return node;
+                }
+                node = it->second.get();
+            }
+            exact = true;
+            return node;
+        }
+
+        // Re-list the changed directories in one walk and push each one's difference up to the root
+        void refreshDirectories(const std::set<std::string>& dirty) {
+            // Removed directories first, so no walk root below is inside a dropped subtree
+            for (const auto& dir_path : dirty) {
+                bool exact = false;
+                Node* node = findNode(dir_path, exact);
+                std::error_code ec;
+                if (!node || !exact || std::filesystem::is_directory(dir_path, ec)) {
+                    continue;
+                }
+                if (node == root_.get()) {
+                    root_ = std::make_unique<Node>();
+                    return;
+                }
+                Node* parent = node->parent;
+                DirectorySizeResult before{parent->total_size, parent->total_files, parent->total_folders};
+                parent->children.erase(node->name);
+                recomputeTotals(parent);
+                propagate(parent, before);
+            }
+
+            // A directory we never saw is picked up as a new child of its nearest known ancestor
+            std::vector<DirectoryVisitor::Directory> roots;
+            std::set<Node*> seen;
+            for (const auto& dir_path : dirty) {
+                bool exact = false;
+                Node* node = findNode(dir_path, exact);
+                if (node && seen.insert(node).second) {
+                    roots.push_back({exact ? std::filesystem::path(dir_path) : nodePath(node), node});
+                }
+            }
+            if (roots.empty()) {
+                return;
+            }
+            NodeLister lister(false);
+            walk(lister, roots);
+            applyWalk(roots, lister.visitedNodes());
+        }
+
+        // Recompute the totals below the roots of a walk and push each root's difference up to the tree root.
+        // Deepest first, so a root inside another one is already accounted for.
+        void applyWalk(const std::vector<DirectoryVisitor::Directory>& roots, const std::unordered_set<Node*>& visited) {
+            std::vector<std::pair<size_t, Node*>> by_depth;
+            for (const auto& root : roots) {
+                auto* node = static_cast<Node*>(root.tag);
+                size_t depth = 0;
+                for (const Node* ancestor = node->parent; ancestor; ancestor = ancestor->parent) {
+                    depth++;
+                }
+                by_depth.emplace_back(depth, node);
+            }
+            std::sort(by_depth.begin(), by_depth.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+            for (const auto& [depth, node] : by_depth) {
+                DirectorySizeResult before{node->total_size, node->total_files, node->total_folders};
+                recomputeSubtree(node, &visited);
+                propagate(node, before);
+            }
+        }
+
+        // Apply a node's change in totals to all of its ancestors, O(depth)
+        static void propagate(Node* node, const DirectorySizeResult& before) {
+            auto size_delta = static_cast<intmax_t>(node->total_size - before.total_size);
+            auto files_delta = static_cast<intmax_t>(node->total_files - before.file_count);
+            auto folders_delta = static_cast<intmax_t>(node->total_folders - before.folder_count);
+            for (Node* ancestor = node->parent; ancestor; ancestor = ancestor->parent) {
+                ancestor->total_size += size_delta;
+                ancestor->total_files += files_delta;
+                ancestor->total_folders += folders_delta;
+            }
+        }
+
+        std::filesystem::path nodePath(const Node* node) const {
+            std::vector<const std::string*> names;
+            for (; node->parent; node = node->parent) {
+                names.push_back(&node->name);
+            }
+            std::filesystem::path path(root_path_);
+            for (auto it = names.rbegin(); it != names.rend(); ++it) {
+                path /= **it;
+            }
+            return path;
+        }
+    };
+
+    // Read-only view of a whole file, mapped into memory
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string& path) {
+            #ifdef _WIN32
+            file_ = CreateFileW(utf8_to_wide(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file_ == INVALID_HANDLE_VALUE) {
+                return;
+            }
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+                return;
+            }
+            mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping_) {
+                return;
+            }
+            void* data = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+            if (data) {
+                data_ = static_cast<const char*>(data);
+                size_ = static_cast<size_t>(size.QuadPart);
+            }
+            #else
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return;
+            }
+            struct stat st{};
+            if (fstat(fd, &st) == 0 && st.st_size > 0) {
+                void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data != MAP_FAILED) {
+                    data_ = static_cast<const char*>(data);
+                    size_ = static_cast<size_t>(st.st_size);
+                }
+            }
+            close(fd);
+            #endif
+        }
+
+        ~MappedFile() {
+            #ifdef _WIN32
+            if (data_) {
+                UnmapViewOfFile(data_);
+            }
+            if (mapping_) {
+                CloseHandle(mapping_);
+            }
+            if (file_ != INVALID_HANDLE_VALUE) {
+                CloseHandle(file_);
+            }
+            #else
+            if (data_) {
+                munmap(const_cast<char*>(data_), size_);
+            }
+            #endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const {
+            return data_;
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+    private:
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+        #ifdef _WIN32
+        HANDLE file_ = INVALID_HANDLE_VALUE;
+        HANDLE mapping_ = nullptr;
+        #endif
+    };
+
+    // Persistent copy of the size trees, so a restart re-lists only the directories that changed meanwhile.
+    // Layout (native byte order): header, one record per tree, the nodes of all trees in preorder, then the names.
+    class ScanIndex {
+    public:
+        using Trees = std::unordered_map<std::string, std::shared_ptr<DirectorySizeTree>>;
+
+        // Write the trees to path.tmp and rename it over path
+        static bool save(const std::string& path, const std::vector<std::shared_ptr<DirectorySizeTree>>& trees) {
+            std::vector<TreeRecord> tree_records;
+            std::vector<NodeRecord> nodes;
+            std::string names;
+            for (const auto& tree : trees) {
+                if (!tree || !tree->root_) {
+                    continue;
+                }
+                TreeRecord record{};
+                record.path_offset = names.size();
+                record.path_length = static_cast<uint32_t>(tree->root_path_.size());
+                names += tree->root_path_;
+                record.node_offset = nodes.size();
+
+                // Preorder, so every parent is written before its children
+                std::vector<std::pair<const DirectorySizeTree::Node*, uint32_t>> pending{{tree->root_.get(), NO_PARENT}};
+                while (!pending.empty()) {
+                    auto [node, parent] = pending.back();
+                    pending.pop_back();
+                    NodeRecord node_record{};
+                    node_record.parent = parent;
+                    node_record.name_length = static_cast<uint32_t>(node->name.size());
+                    node_record.name_offset = names.size();
+                    node_record.inode = node->identity.inode;
+                    node_record.mtime_ns = node->identity.mtime_ns;
+                    node_record.ctime_ns = node->identity.ctime_ns;
+                    node_record.own_size = node->own_size;
+                    node_record.own_files = node->own_files;
+                    node_record.own_folders = node->own_folders;
+                    names += node->name;
+                    auto self = static_cast<uint32_t>(nodes.size() - record.node_offset);
+                    nodes.push_back(node_record);
+                    for (const auto& [name, child] : node->children) {
+                        pending.emplace_back(child.get(), self);
+                    }
+                }
+                record.node_count = nodes.size() - record.node_offset;
+                if (record.node_count >= NO_PARENT) {
+                    nodes.resize(record.node_offset);
+                    continue;
+                }
+                tree_records.push_back(record);
+            }
+
+            Header header{};
+            std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+            header.version = VERSION;
+            header.byte_order = BYTE_ORDER_MARK;
+            header.tree_count = tree_records.size();
+            header.node_count = nodes.size();
+            header.file_size = sizeof(Header) + tree_records.size() * sizeof(TreeRecord) + nodes.size() * sizeof(NodeRecord) + names.size();
+
+            std::string temp_path = path + ".tmp";
+            {
+                std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+                out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                out.write(reinterpret_cast<const char*>(tree_records.data()), static_cast<std::streamsize>(tree_records.size() * sizeof(TreeRecord)));
+                out.write(reinterpret_cast<const char*>(nodes.data()), static_cast<std::streamsize>(nodes.size() * sizeof(NodeRecord)));
+                out.write(names.data(), static_cast<std::streamsize>(names.size()));
+                if (!out) {
+                    logWarning() << "Warning: Cannot write scan index " << temp_path;
+                    return false;
+                }
+            }
+            std::error_code ec;
+            std::filesystem::rename(temp_path, path, ec);
+            if (ec) {
+                logWarning() << "Warning: Cannot replace scan index " << path << ": " << ec.message();
+                return false;
+            }
+            return true;
+        }
+
+        // Map the index and rebuild its trees; a missing, foreign or damaged file yields no trees
+        static Trees load(const std::string& path) {
+            Trees trees;
+            MappedFile file(path);
+            if (!file.data()) {
+                return trees;
+            }
+            const char* data = file.data();
+            size_t size = file.size();
+
+            Header header;
+            if (size < sizeof(Header)) {
+                logWarning() << "Warning: Ignoring truncated scan index " << path;
+                return trees;
+            }
+            std::memcpy(&header, data, sizeof(header));
+            if (std::memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0 || header.version != VERSION ||
+                header.byte_order != BYTE_ORDER_MARK || header.file_size != size ||
+                header.tree_count > (size - sizeof(Header)) / sizeof(TreeRecord) ||
+                header.node_count > (size - sizeof(Header) - header.tree_count * sizeof(TreeRecord)) / sizeof(NodeRecord)) {
+                logWarning() << "Warning: Ignoring incompatible or damaged scan index " << path;
+                return trees;
+            }
+
+            const char* tree_records = data + sizeof(Header);
+            const char* node_records = tree_records + header.tree_count * sizeof(TreeRecord);
+            std::string_view names(node_records + header.node_count * sizeof(NodeRecord),
+                                   size - sizeof(Header) - header.tree_count * sizeof(TreeRecord) - header.node_count * sizeof(NodeRecord));
+            for (uint64_t t = 0; t < header.tree_count; t++) {
+                TreeRecord record;
+                std::memcpy(&record, tree_records + t * sizeof(TreeRecord), sizeof(record));
+                std::shared_ptr<DirectorySizeTree> tree;
+                if (record.node_count == 0 || record.node_count >= NO_PARENT || record.node_offset > header.node_count ||
+                    record.node_count > header.node_count - record.node_offset ||
+                    !(tree = buildTree(record, node_records, names))) {
+                    logWarning() << "Warning: Ignoring damaged scan index " << path;
+                    return {};
+                }
+                std::string root_path = tree->root_path_;
+                trees[root_path] = std::move(tree);
+            }
+            return trees;
+        }
+
+    private:
+        static constexpr char MAGIC[8] = {'F', 'S', 'M', 'I', 'N', 'D', 'E', 'X'};
+        static constexpr uint32_t VERSION = 3;
+        static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+        static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t byte_order;    // Written natively; an index from another byte order is rejected
+            uint64_t tree_count;
+            uint64_t node_count;    // Over all trees
+            uint64_t file_size;
+        };
+
+        struct TreeRecord {
+            uint64_t path_offset;   // Into the names, like all offsets below
+            uint32_t path_length;
+            uint32_t reserved;
+            uint64_t node_offset;   // Index of the tree's root in the node array
+            uint64_t node_count;
+        };
+
+        struct NodeRecord {
+            uint32_t parent;        // Index within the tree, NO_PARENT for the root
+            uint32_t name_length;
+            uint64_t name_offset;
+            uint64_t inode;
+            int64_t mtime_ns;
+            int64_t ctime_ns;
+            uint64_t own_size;
+            uint64_t own_files;
+            uint64_t own_folders;
+        };
+
+        static_assert(sizeof(Header) == 40 && sizeof(TreeRecord) == 32 && sizeof(NodeRecord) == 64, "Scan index layout changed");
+
+        static bool nameAt(std::string_view names, uint64_t offset, uint32_t length, std::string_view& name) {
+            if (offset > names.size() || length > names.size() - offset) {
+                return false;
+            }
+            name = names.substr(offset, length);
+            return true;
+        }
+
+        // Recreate the nodes of one tree; totals are recomputed rather than trusted from the file
+        static std::shared_ptr<DirectorySizeTree> buildTree(const TreeRecord& record, const char* node_records, std::string_view names) {
+            std::string_view root_path;
+            if (!nameAt(names, record.path_offset, record.path_length, root_path) || root_path.empty()) {
+                return nullptr;
+            }
+            auto tree = std::make_shared<DirectorySizeTree>(std::string(root_path));
+            std::vector<DirectorySizeTree::Node*> order;
+            order.reserve(record.node_count);
+            for (uint64_t i = 0; i < record.node_count; i++) {
+                NodeRecord node_record;
+                std::memcpy(&node_record, node_records + (record.node_offset + i) * sizeof(NodeRecord), sizeof(node_record));
+                std::string_view name;
+                if (!nameAt(names, node_record.name_offset, node_record.name_length, name)) {
+                    return nullptr;
+                }
+
+                auto node = std::make_unique<DirectorySizeTree::Node>();
+                node->name = std::string(name);
+                node->identity = {node_record.inode, node_record.mtime_ns, node_record.ctime_ns};
+                node->own_size = static_cast<uintmax_t>(node_record.own_size);
+                node->own_files = static_cast<size_t>(node_record.own_files);
+                node->own_folders = static_cast<size_t>(node_record.own_folders);
+                order.push_back(node.get());
+                if (i == 0) {
+                    if (node_record.parent != NO_PARENT) {
+                        return nullptr;
+                    }
+                    tree->root_ = std::move(node);
+                    continue;
+                }
+                // Preorder: the parent must already exist
+                if (node_record.parent >= i || name.empty()) {
+                    return nullptr;
+                }
+                DirectorySizeTree::Node* parent = order[node_record.parent];
+                node->parent = parent;
+                if (!parent->children.emplace(node->name, std::move(node)).second) {
+                    return nullptr;
+                }
+            }
+            for (auto it = order.rbegin(); it != order.rend(); ++it) {
+                DirectorySizeTree::recomputeTotals(*it);
+            }
+            // Dirty directories and validation start out clean; the owner decides via revalidate()
+            tree->needs_rebuild_ = false;
+            return tree;
+        }
+    };
+
+    // Get directory size with proper encoding handling
+    static double getDirectorySize(const std::string& dir_path) {
+        DirectorySizeResult result = calculateDirectorySize(dir_path);
+        return static_cast<double>(result.total_size);
+    }
+
+#ifdef FSM_IO_URING_BACKEND
+    // Batches statx/unlinkat calls through io_uring: one io_uring_enter per batch instead of one syscall per entry
+    class IoUringBatch {
+    public:
+        struct StatxRequest {
+            const char* name;
+            int flags;
+            unsigned mask;
+            struct statx* buffer;
+            int result; // 0 or -errno
+        };
+
+        struct UnlinkRequest {
+            const char* name;
+            int flags;
+            int result; // 0 or -errno
+        };
+
+        // Probe once whether the kernel allows io_uring and supports the opcodes we submit
+        static bool supported() {
+            static const bool result = [] {
+                IoUringBatch ring(8);
+                return ring.valid() && ring.opcodesSupported();
+            }();
+            return result;
+        }
+
+        explicit IoUringBatch(unsigned entries = 256) {
+            #ifdef FSM_HAVE_LIBURING
+            valid_ = io_uring_queue_init(entries, &ring_, 0) == 0;
+            if (valid_) {
+                capacity_ = ring_.sq.ring_entries;
+            }
+            #else
+            io_uring_params params{};
+            ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+            if (ring_fd_ < 0) {
+                return;
+            }
+            sq_len_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_len_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (single_mmap) {
+                sq_len_ = cq_len_ = std::max(sq_len_, cq_len_);
+            }
+            sq_ptr_ = mmap(nullptr, sq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+            if (sq_ptr_ == MAP_FAILED) {
+                sq_ptr_ = nullptr;
+                return;
+            }
+            cq_ptr_ = single_mmap ? sq_ptr_ : mmap(nullptr, cq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+            if (cq_ptr_ == MAP_FAILED) {
+                cq_ptr_ = nullptr;
+                return;
+            }
+            sqes_len_ = params.sq_entries * sizeof(io_uring_sqe);
+            void* sqes = mmap(nullptr, sqes_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+            if (sqes == MAP_FAILED) {
+                return;
+            }
+            sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+            auto* sq = static_cast<char*>(sq_ptr_);
+            auto* cq = static_cast<char*>(cq_ptr_);
+            sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            local_tail_ = *sq_tail_;
+            capacity_ = params.sq_entries;
+            valid_ = true;
+            #endif
+        }
+
+        ~IoUringBatch() {
+            #ifdef FSM_HAVE_LIBURING
+            if (valid_) {
+                io_uring_queue_exit(&ring_);
+            }
+            #else
+            if (sqes_) {
+                munmap(sqes_, sqes_len_);
+            }
+            if (cq_ptr_ && cq_ptr_ != sq_ptr_) {
+                munmap(cq_ptr_, cq_len_);
+            }
+            if (sq_ptr_) {
+                munmap(sq_ptr_, sq_len_);
+            }
+            if (ring_fd_ >= 0) {
+                close(ring_fd_);
+            }
+            #endif
+        }
+
+        IoUringBatch(const IoUringBatch&) = delete;
+        IoUringBatch& operator=(const IoUringBatch&) = delete;
+
+        bool valid() const {
+            return valid_;
+        }
+
+        // statx every request relative to dirfd
+        void statx(int dirfd, StatxRequest* requests, size_t count) {
+            run(count,
+                [&](size_t i, io_uring_sqe* sqe) {
+                    sqe->opcode = IORING_OP_STATX;
+                    sqe->fd = dirfd;
+                    sqe->addr = reinterpret_cast<uintptr_t>(requests[i].name);
+                    sqe->len = requests[i].mask;
+                    sqe->off = reinterpret_cast<uintptr_t>(requests[i].buffer);
+                    sqe->statx_flags = static_cast<unsigned>(requests[i].flags);
+                },
+                [&](size_t i, int result) { requests[i].result = result; });
+        }
+
+        // unlinkat every request relative to dirfd
+        void unlink(int dirfd, UnlinkRequest* requests, size_t count) {
+            run(count,
+                [&](size_t i, io_uring_sqe* sqe) {
+                    sqe->opcode = IORING_OP_UNLINKAT;
+                    sqe->fd = dirfd;
+                    sqe->addr = reinterpret_cast<uintptr_t>(requests[i].name);
+                    sqe->unlink_flags = static_cast<unsigned>(requests[i].flags);
+                },
+                [&](size_t i, int result) { requests[i].result = result; });
+        }
+
+    private:
+        bool valid_ = false;
+        unsigned capacity_ = 0;
+        #ifdef FSM_HAVE_LIBURING
+        io_uring ring_{};
+        #else
+        int ring_fd_ = -1;
+        void* sq_ptr_ = nullptr;
+        void* cq_ptr_ = nullptr;
+        size_t sq_len_ = 0;
+        size_t cq_len_ = 0;
+        size_t sqes_len_ = 0;
+        io_uring_sqe* sqes_ = nullptr;
+        io_uring_cqe* cqes_ = nullptr;
+        unsigned* sq_tail_ = nullptr;
+        unsigned* sq_array_ = nullptr;
+        unsigned* cq_head_ = nullptr;
+        unsigned* cq_tail_ = nullptr;
+        unsigned sq_mask_ = 0;
+        unsigned cq_mask_ = 0;
+        unsigned local_tail_ = 0;
+        #endif
+
+        bool opcodesSupported() {
+            std::vector<char> storage(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+            auto* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+            #ifdef FSM_HAVE_LIBURING
+            int fd = ring_.ring_fd;
+            #else
+            int fd = ring_fd_;
+            #endif
+            if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+                return false;
+            }
+            auto opcode_ok = [probe](unsigned op) {
+                return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+            };
+            return opcode_ok(IORING_OP_STATX) && opcode_ok(IORING_OP_UNLINKAT);
+        }
+
+        // Keep the ring full: queue as many requests as fit, submit, reap, repeat
+        template <typename Prepare, typename Complete>
+        void run(size_t count, Prepare prepare, Complete complete) {
+            size_t submitted = 0;
+            size_t completed = 0;
+            while (completed < count) {
+                unsigned queued = 0;
+                while (submitted < count && submitted - completed < capacity_) {
+                    io_uring_sqe* sqe = nextSqe();
+                    if (!sqe) {
+                        break;
+                    }
+                    std::memset(sqe, 0, sizeof(*sqe));
+                    prepare(submitted, sqe);
+                    sqe->user_data = submitted;
+                    submitted++;
+                    queued++;
+                }
+                if (!submitAndWait(queued)) {
+                    // The ring broke down: fail whatever is still outstanding
+                    for (size_t i = completed; i < count; i++) {
+                        complete(i, -EIO);
+                    }
+                    return;
+                }
+                completed += reap(complete);
+            }
+        }
+
+        #ifdef FSM_HAVE_LIBURING
+        io_uring_sqe* nextSqe() {
+            return io_uring_get_sqe(&ring_);
+        }
+
+        bool submitAndWait(unsigned) {
+            int result;
+            do {
+                result = io_uring_submit_and_wait(&ring_, 1);
+            } while (result == -EINTR);
+            return result >= 0;
+        }
+
+        template <typename Complete>
+        size_t reap(Complete& complete) {
+            io_uring_cqe* cqe;
+            unsigned head;
+            size_t reaped = 0;
+            io_uring_for_each_cqe(&ring_, head, cqe) {
+                complete(static_cast<size_t>(cqe->user_data), cqe->res);
+                reaped++;
+            }
+            io_uring_cq_advance(&ring_, static_cast<unsigned>(reaped));
+            return reaped;
+        }
+        #else
+        // Only this thread produces, so the tail is published once per batch
+        io_uring_sqe* nextSqe() {
+            unsigned index = local_tail_ & sq_mask_;
+            sq_array_[index] = index;
+            local_tail_++;
+            return &sqes_[index];
+        }
+
+        bool submitAndWait(unsigned queued) {
+            __atomic_store_n(sq_tail_, local_tail_, __ATOMIC_RELEASE);
+            while (true) {
+                long result = syscall(__NR_io_uring_enter, ring_fd_, queued, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                if (result < 0) {
+                    if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                        return false;
+                    }
+                    std::this_thread::yield();
+                    continue;
+                }
+                // Entries the kernel did not consume yet stay in the ring for the next call
+                queued -= static_cast<unsigned>(result);
+                if (queued == 0) {
+                    return true;
+                }
+            }
+        }
+
+        template <typename Complete>
+        size_t reap(Complete& complete) {
+            unsigned head = *cq_head_;
+            unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            size_t reaped = 0;
+            for (; head != tail; head++, reaped++) {
+                const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+                complete(static_cast<size_t>(cqe.user_data), cqe.res);
+            }
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+            return reaped;
+        }
+        #endif
+    };
+#endif
+
+    // Work-stealing task pool: each thread pops its own deque LIFO (depth first, bounded memory) and
+    // steals FIFO from the others when idle (largest subtrees). Tasks may push further tasks.
+    template <typename Task>
+    class WorkStealingPool {
+    public:
+        explicit WorkStealingPool(size_t thread_count) : thread_count_(std::max<size_t>(1, thread_count)) {
+            for (size_t i = 0; i < thread_count_; i++) {
+                queues_.push_back(std::make_unique<WorkerQueue>());
+            }
+        }
+
+        size_t threadCount() const {
+            return thread_count_;
+        }
+
+        // Run handler(task, worker) until no task is left; the calling thread is worker 0
+        template <typename Handler>
+        void run(Task initial, Handler handler) {
+            push(0, std::move(initial));
+
+            std::vector<std::thread> threads;
+            for (size_t i = 1; i < thread_count_; i++) {
+                threads.emplace_back([this, &handler, i] { workerLoop(i, handler); });
+            }
+            workerLoop(0, handler);
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+
+        // Run handler over a batch of independent tasks, spread round-robin over the workers
+        template <typename Handler>
+        void run(const std::vector<Task>& initial, Handler handler) {
+            for (size_t i = 0; i < initial.size(); i++) {
+                push(i % thread_count_, initial[i]);
+            }
+
+            std::vector<std::thread> threads;
+            for (size_t i = 1; i < thread_count_; i++) {
+                threads.emplace_back([this, &handler, i] { workerLoop(i, handler); });
+            }
+            workerLoop(0, handler);
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+
+        void push(size_t worker, Task task) {
+            pending_.fetch_add(1, std::memory_order_acq_rel);
+            WorkerQueue& own = *queues_[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            own.tasks.push_back(std::move(task));
+        }
+
+        void push(size_t worker, std::vector<Task>& tasks) {
+            if (tasks.empty()) {
+                return;
+            }
+            pending_.fetch_add(tasks.size(), std::memory_order_acq_rel);
+            WorkerQueue& own = *queues_[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            for (auto& task : tasks) {
+                own.tasks.push_back(std::move(task));
+            }
+            tasks.clear();
+        }
+
+    private:
+        struct WorkerQueue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        size_t thread_count_;
+        std::vector<std::unique_ptr<WorkerQueue>> queues_;
+        std::atomic<size_t> pending_{0}; // Tasks queued or being processed
+
+        bool nextTask(size_t self, Task& task) {
+            {
+                WorkerQueue& own = *queues_[self];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.tasks.empty()) {
+                    task = std::move(own.tasks.back());
+                    own.tasks.pop_back();
+                    return true;
+                }
+            }
+            for (size_t offset = 1; offset < thread_count_; offset++) {
+                WorkerQueue& victim = *queues_[(self + offset) % thread_count_];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty()) {
+                    task = std::move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        template <typename Handler>
+        void workerLoop(size_t self, Handler& handler) {
+            if (self != 0) {
+                Tracer::nameThread("pool worker");
+            }
+            Task task;
+            int idle_rounds = 0;
+            while (pending_.load(std::memory_order_acquire) > 0) {
+                if (!nextTask(self, task)) {
+                    // Back off while the remaining tasks are being expanded by other threads
+                    if (++idle_rounds < 64) {
+                        std::this_thread::yield();
+                    } else {
+                        std::this_thread::sleep_for(std::chrono::microseconds(200));
+                    }
+                    continue;
+                }
+                idle_rounds = 0;
+                handler(task, self);
+                pending_.fetch_sub(1, std::memory_order_acq_rel);
+            }
+        }
+    };
+
+    // Runs tasks on a set of threads while limiting how many tasks of one group (a device) are in flight.
+    // A task running past the timeout is given up: its thread is left behind to finish on its own and
+    // its slot is freed. After too many timeouts in one group the rest of that group is skipped.
+    class DeviceBoundedPool {
+    public:
+        struct Outcome {
+            std::vector<size_t> timed_out;
+            std::vector<size_t> skipped;
+        };
+
+        DeviceBoundedPool(size_t thread_count, std::chrono::steady_clock::duration timeout, size_t max_timeouts)
+            : state_(std::make_shared<State>()), thread_count_(std::max<size_t>(1, thread_count)),
+              timeout_(timeout), max_timeouts_(std::max<size_t>(1, max_timeouts)) {}
+
+        void add(uint64_t device, size_t limit, size_t id, std::function<void()> work) {
+            State& state = *state_;
+            auto it = state.group_index.find(device);
+            if (it == state.group_index.end()) {
+                it = state.group_index.emplace(device, state.groups.size()).first;
+                state.groups.push_back(Group{std::max<size_t>(1, limit), 0, 0, {}});
+            }
+            state.groups[it->second].tasks.push_back(Task{id, std::move(work)});
+            state.queued++;
+        }
+
+        // Run until every task finished, timed out or was skipped; the calling thread only supervises
+        Outcome run() {
+            State& state = *state_;
+            Outcome outcome;
+            size_t thread_count = std::min(thread_count_, state.queued);
+            state.stuck.assign(thread_count, false);
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < thread_count; i++) {
+                threads.emplace_back([state = state_, i] { workerLoop(*state, i); });
+            }
+            // A stuck worker is replaced, so a hung device cannot take every thread; bounded, since each
+            // group gives up after max_timeouts_ timeouts anyway
+            size_t replacements_left = thread_count_ * max_timeouts_;
+
+            {
+                std::unique_lock<std::mutex> lock(state.mutex);
+                while (state.queued > 0 || !state.running.empty()) {
+                    auto now = std::chrono::steady_clock::now();
+                    auto wake = now + timeout_;
+                    bool freed = false;
+                    for (auto it = state.running.begin(); it != state.running.end();) {
+                        if (now - it->second.started < timeout_) {
+                            wake = std::min(wake, it->second.started + timeout_);
+                            ++it;
+                            continue;
+                        }
+                        Group& group = state.groups[it->second.group];
+                        group.in_flight--;
+                        group.timeouts++;
+                        state.stuck[it->second.worker] = true;
+                        outcome.timed_out.push_back(it->second.id);
+                        if (group.timeouts >= max_timeouts_) {
+                            for (const Task& task : group.tasks) {
+                                outcome.skipped.push_back(task.id);
+                            }
+                            state.queued -= group.tasks.size();
+                            group.tasks.clear();
+                        }
+                        it = state.running.erase(it);
+                        freed = true;
+                    }
+                    if (freed) {
+                        size_t live = static_cast<size_t>(std::count(state.stuck.begin(), state.stuck.end(), false));
+                        while (state.queued > 0 && live < thread_count && replacements_left > 0) {
+                            size_t worker = state.stuck.size();
+                            state.stuck.push_back(false);
+                            threads.emplace_back([state = state_, worker] { workerLoop(*state, worker); });
+                            live++;
+                            replacements_left--;
+                        }
+                        if (live == 0) {
+                            // No worker left to serve the queue: give the remaining tasks up rather than wait
+                            for (Group& group : state.groups) {
+                                for (const Task& task : group.tasks) {
+                                    outcome.skipped.push_back(task.id);
+                                }
+                                group.tasks.clear();
+                            }
+                            state.queued = 0;
+                        }
+                        state.changed.notify_all();
+                        continue;
+                    }
+                    state.changed.wait_until(lock, wake);
+                }
+                state.finished = true;
+                state.changed.notify_all();
+            }
+
+            for (size_t i = 0; i < threads.size(); i++) {
+                if (state.stuck[i]) {
+                    threads[i].detach();
+                } else {
+                    threads[i].join();
+                }
+            }
+            return outcome;
+        }
+
+    private:
+        struct Task {
+            size_t id;
+            std::function<void()> work;
+        };
+
+        struct Group {
+            size_t limit;
+            size_t in_flight;
+            size_t timeouts;
+            std::deque<Task> tasks;
+        };
+
+        struct Running {
+            size_t id;
+            size_t group;
+            size_t worker;
+            std::chrono::steady_clock::time_point started;
+        };
+
+        // Shared with the workers, so a worker stuck past run() still has valid state to return to
+        struct State {
+            std::mutex mutex;
+            std::condition_variable changed;
+            std::unordered_map<uint64_t, size_t> group_index;
+            std::vector<Group> groups;
+            std::unordered_map<uint64_t, Running> running; // By token
+            std::vector<bool> stuck;                       // Workers inside a task that timed out
+            uint64_t next_token = 0;
+            size_t queued = 0;
+            size_t cursor = 0; // Round-robin start, so one device cannot starve the others
+            bool finished = false;
+        };
+
+        std::shared_ptr<State> state_;
+        size_t thread_count_;
+        std::chrono::steady_clock::duration timeout_;
+        size_t max_timeouts_;
+
+        static void workerLoop(State& state, size_t self) {
+            Tracer::nameThread("check worker");
+            std::unique_lock<std::mutex> lock(state.mutex);
+            while (!state.finished) {
+                size_t group_id = state.groups.size();
+                for (size_t i = 0; i < state.groups.size(); i++) {
+                    size_t candidate = (state.cursor + i) % state.groups.size();
+                    Group& group = state.groups[candidate];
+                    if (!group.tasks.empty() && group.in_flight < group.limit) {
+                        group_id = candidate;
+                        state.cursor = (candidate + 1) % state.groups.size();
+                        break;
+                    }
+                }
+                if (group_id == state.groups.size()) {
+                    if (state.queued == 0) {
+                        break;
+                    }
+                    // Every device with work left is at its limit
+                    Tracer::Scope trace_scope("device limit wait");
+                    state.changed.wait(lock);
+                    continue;
+                }
+
+                Group& group = state.groups[group_id];
+                Task task = std::move(group.tasks.front());
+                group.tasks.pop_front();
+                group.in_flight++;
+                state.queued--;
+                uint64_t token = state.next_token++;
+                state.running[token] = Running{task.id, group_id, self, std::chrono::steady_clock::now()};
+                state.stuck[self] = false;
+
+                lock.unlock();
+                task.work();
+                lock.lock();
+
+                auto it = state.running.find(token);
+                if (it == state.running.end()) {
+                    // Timed out and replaced: leave the queue to the replacement
+                    break;
+                }
+                state.groups[group_id].in_flight--;
+                state.running.erase(it);
+                state.changed.notify_all();
+            }
+        }
+    };
+
+    // Keeps the oldest files seen by a walk in bounded per-thread max-heaps, so eviction never needs the full file list
+    class EvictionCollector {
+    public:
+        struct Candidate {
+            int64_t time;   // mtime or atime, nanoseconds
+            uintmax_t size;
+            std::string path;
+
+            bool operator<(const Candidate& other) const {
+                return time < other.time;
+            }
+        };
+
+        EvictionCollector(size_t limit, bool by_atime) : limit_(std::max<size_t>(1, limit)), by_atime_(by_atime) {}
+
+        bool byAtime() const {
+            return by_atime_;
+        }
+
+        size_t limit() const {
+            return limit_;
+        }
+
+        void prepare(size_t threads) {
+            heaps_ = std::vector<Heap>(threads);
+        }
+
+        // Cheap test before the path is built: would this file make it into the heap?
+        bool wants(size_t worker, int64_t time) const {
+            const auto& heap = heaps_[worker].candidates;
+            return heap.size() < limit_ || time < heap.front().time;
+        }
+
+        void offer(size_t worker, int64_t time, uintmax_t size, std::string path) {
+            auto& heap = heaps_[worker].candidates;
+            if (heap.size() >= limit_) {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.pop_back();
+            }
+            heap.push_back({time, size, std::move(path)});
+            std::push_heap(heap.begin(), heap.end());
+        }
+
+        // Merge the per-thread heaps into the overall oldest files, oldest first
+        std::vector<Candidate> takeOldest() {
+            std::vector<Candidate> merged;
+            for (auto& heap : heaps_) {
+                std::move(heap.candidates.begin(), heap.candidates.end(), std::back_inserter(merged));
+                heap.candidates.clear();
+            }
+            std::sort(merged.begin(), merged.end());
+            if (merged.size() > limit_) {
+                merged.resize(limit_);
+            }
+            return merged;
+        }
+
+    private:
+        struct alignas(64) Heap {
+            std::vector<Candidate> candidates; // Max-heap on time, the newest candidate is dropped first
+        };
+
+        size_t limit_;
+        bool by_atime_;
+        std::vector<Heap> heaps_;
+    };
+
+    // Advance a virtual clock (GCRA) by the cost of a request and return when the request may proceed;
+    // up to burst of work may run ahead of the rate
+    static std::chrono::steady_clock::time_point reserveRate(std::chrono::steady_clock::time_point& clock,
+                                                             std::chrono::steady_clock::time_point now,
+                                                             double amount, double rate, double burst_seconds) {
+        if (rate <= 0 || amount <= 0) {
+            return now;
+        }
+        auto burst = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(burst_seconds));
+        clock = std::max(clock, now - burst) +
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(amount / rate));
+        return clock - burst;
+    }
+
+    // Process-wide token buckets in front of every scan. Under I/O pressure (PSI of the system and of
+    // our cgroup) the rates are halved each sample, and they grow back by a quarter once pressure clears.
+    class ScanGovernor {
+    public:
+        static constexpr double DEFAULT_STATS_PER_SECOND = 50000;
+        static constexpr double DEFAULT_DIRS_PER_SECOND = 5000;
+
+        void configure(const ScanBudget& budget) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            budget_ = budget;
+            // Pressure needs a rate to scale, fall back to defaults when none is given
+            if (budget_.psi_threshold > 0 && budget_.stats_per_second <= 0 && budget_.dirs_per_second <= 0) {
+                budget_.stats_per_second = DEFAULT_STATS_PER_SECOND;
+                budget_.dirs_per_second = DEFAULT_DIRS_PER_SECOND;
+            }
+            active_.store(budget_.governed());
+        }
+
+        // Block until the given number of stat calls and directory reads fit into the budget
+        void acquire(size_t stats, size_t dir_reads) {
+            metrics().countSyscalls(stats, dir_reads);
+            FSM_STAT_ADD(StatCalls, stats);
+            if (!active_.load(std::memory_order_relaxed)) {
+                return;
+            }
+            std::chrono::steady_clock::time_point until;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto now = std::chrono::steady_clock::now();
+                double scale = pressureScale(now);
+                until = std::max(reserveRate(stat_clock_, now, static_cast<double>(stats), budget_.stats_per_second * scale, BURST_SECONDS),
+                                 reserveRate(dir_clock_, now, static_cast<double>(dir_reads), budget_.dirs_per_second * scale, BURST_SECONDS));
+            }
+            if (until > std::chrono::steady_clock::now()) {
+                Tracer::Scope trace_scope("governor wait");
+                std::this_thread::sleep_until(until);
+            }
+        }
+
+    private:
+        static constexpr double BURST_SECONDS = 0.1;
+        static constexpr double MIN_SCALE = 0.05;
+
+        std::atomic<bool> active_{false};
+        std::mutex mutex_;
+        ScanBudget budget_;
+        std::chrono::steady_clock::time_point stat_clock_{};
+        std::chrono::steady_clock::time_point dir_clock_{};
+        std::chrono::steady_clock::time_point next_sample_{};
+        double scale_ = 1.0;
+
+        // Multiplicative decrease above the threshold, gradual increase below half of it
+        double pressureScale(std::chrono::steady_clock::time_point now) {
+            if (budget_.psi_threshold <= 0 || now < next_sample_) {
+                return scale_;
+            }
+            next_sample_ = now + std::chrono::seconds(2);
+            double pressure = ioPressure();
+            if (pressure < 0) {
+                return scale_;
+            }
+            double previous = scale_;
+            if (pressure > budget_.psi_threshold) {
+                scale_ = std::max(MIN_SCALE, scale_ * 0.5);
+            } else if (pressure < budget_.psi_threshold / 2) {
+                scale_ = std::min(1.0, scale_ * 1.25);
+            }
+            if ((previous == 1.0) != (scale_ == 1.0)) {
+                logWarning() << (scale_ < 1.0 ? "Warning: I/O pressure " : "I/O pressure ") << formatFixed(pressure, 2) << "%, scan rate " << (scale_ < 1.0 ? "reduced" : "restored");
+            }
+            return scale_;
+        }
+
+        // Highest io "some avg10" of the system and of our cgroup, -1 when PSI is not available
+        static double ioPressure() {
+            double pressure = -1;
+            #ifdef __linux__
+            std::string group = "/";
+            std::ifstream proc_cgroup("/proc/self/cgroup");
+            std::string line;
+            while (std::getline(proc_cgroup, line)) {
+                if (line.compare(0, 3, "0::") == 0) {
+                    group = line.substr(3);
+                }
+            }
+            for (const std::string& file : {std::string("/proc/pressure/io"), "/sys/fs/cgroup" + group + "/io.pressure"}) {
+                std::ifstream psi(file);
+                while (std::getline(psi, line)) {
+                    // "some avg10=1.23 avg60=0.50 avg300=0.10 total=12345"
+                    size_t avg10 = line.find("avg10=");
+                    if (line.compare(0, 4, "some") == 0 && avg10 != std::string::npos) {
+                        pressure = std::max(pressure, std::atof(line.c_str() + avg10 + 6));
+                    }
+                }
+            }
+            #endif
+            return pressure;
+        }
+    };
+
+    static ScanGovernor& scanGovernor() {
+        static ScanGovernor governor;
+        return governor;
+    }
+
+    // Parallel directory walker: every directory is a task of a WorkStealingPool,
+    // per-thread partial results are merged at the end
+    class ParallelDirectoryWalker {
+    public:
+        using Directory = DirectoryVisitor::Directory;
+
+        ParallelDirectoryWalker(size_t thread_count, ScanBackend backend)
+            : pool_(thread_count),
+              raw_(backend == ScanBackend::Raw || backend == ScanBackend::Uring),
+              uring_(backend == ScanBackend::Uring) {}
+
+        // Walk the tree; a collector additionally receives every regular file with its time stamp
+        DirectorySizeResult walk(const std::filesystem::path& root, EvictionCollector* collector = nullptr) {
+            collector_ = collector;
+            visitor_ = nullptr;
+            if (collector_) {
+                collector_->prepare(pool_.threadCount());
+            }
+            partials_ = std::vector<Partial>(pool_.threadCount());
+            pool_.run(Directory{root}, [this](const Directory& dir, size_t self) { scanDirectory(dir, self); });
+            return mergedResult();
+        }
+
+        // Walk from several directories at once, letting the visitor see and steer every directory
+        void walk(const std::vector<Directory>& roots, DirectoryVisitor& visitor) {
+            collector_ = nullptr;
+            visitor_ = &visitor;
+            partials_ = std::vector<Partial>(pool_.threadCount());
+            pool_.run(roots, [this](const Directory& dir, size_t self) { scanDirectory(dir, self); });
+            visitor_ = nullptr;
+        }
+
+    private:
+        DirectorySizeResult mergedResult() const {
+            DirectorySizeResult result{0, 0, 0};
+            for (const auto& partial : partials_) {
+                result.total_size += partial.result.total_size;
+                result.file_count += partial.result.file_count;
+                result.folder_count += partial.result.folder_count;
+            }
+            return result;
+        }
+
+        // Padded so threads do not share cache lines while counting
+        struct alignas(64) Partial {
+            DirectorySizeResult result{0, 0, 0};
+            #ifdef __linux__
+            std::vector<char> dirent_buffer; // getdents64 buffer of the raw backend
+            std::vector<const char*> stat_names;
+            std::vector<unsigned char> stat_types;
+            std::vector<struct statx> stat_buffers;
+            #endif
+            #ifdef FSM_IO_URING_BACKEND
+            std::unique_ptr<IoUringBatch> ring;
+            std::vector<IoUringBatch::StatxRequest> stat_requests;
+            #endif
+        };
+
+        WorkStealingPool<Directory> pool_;
+        bool raw_;
+        bool uring_;
+        EvictionCollector* collector_ = nullptr;
+        DirectoryVisitor* visitor_ = nullptr;
+        std::vector<Partial> partials_;
+
+        // Time stamp used to order eviction candidates, from a path (portable backend)
+        int64_t candidateTime(const std::filesystem::directory_entry& entry) const {
+            #ifdef _WIN32
+            std::error_code ec;
+            return static_cast<int64_t>(entry.last_write_time(ec).time_since_epoch().count());
+            #else
+            struct stat st{};
+            if (::stat(entry.path().c_str(), &st) != 0) {
+                return 0;
+            }
+            const struct timespec& ts = collector_->byAtime() ? st.st_atim : st.st_mtim;
+            return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+            #endif
+        }
+
+        // Account the direct entries of one directory and queue its subdirectories
+        void scanDirectory(const Directory& dir, size_t self) {
+            std::vector<Directory> subdirs;
+            if (visitor_ && !visitor_->enter(dir, subdirs)) {
+                pool_.push(self, subdirs);
+                return;
+            }
+            const std::filesystem::path& dir_path = dir.path;
+            DirectorySizeResult before = partials_[self].result;
+            {
+                FSM_STAT_SCOPE(Directory);
+                Tracer::Scope trace_scope("scan directory", dir_path);
+                #ifdef __linux__
+                if (raw_) {
+                    scanDirectoryRaw(dir_path, self, subdirs);
+                } else {
+                    scanDirectoryFilesystem(dir_path, self, subdirs);
+                }
+                #else
+                scanDirectoryFilesystem(dir_path, self, subdirs);
+                #endif
+            }
+
+            if (visitor_) {
+                const DirectorySizeResult& after = partials_[self].result;
+                visitor_->listed(dir, {after.total_size - before.total_size, after.file_count - before.file_count,
+                                       after.folder_count - before.folder_count}, subdirs);
+            }
+            pool_.push(self, subdirs);
+        }
+
+        void scanDirectoryFilesystem(const std::filesystem::path& dir_path, size_t self, std::vector<Directory>& subdirs) {
+            DirectorySizeResult& partial = partials_[self].result;
+            FSM_STAT_ADD(DirectoriesOpened, 1);
+            ScanGovernor& governor = scanGovernor();
+            governor.acquire(0, 1);
+
+            std::error_code ec;
+            for (std::filesystem::directory_iterator it(dir_path, ec), end; !ec && it != end; it.increment(ec)) {
+                governor.acquire(1, 0);
+                FSM_STAT_ADD(EntriesRead, 1);
+                if (it->path().filename() == GRAVEYARD_NAME) {
+                    continue;
+                }
+                try {
+                    if (std::filesystem::is_regular_file(*it)) {
+                        uintmax_t size = std::filesystem::file_size(*it);
+                        partial.total_size += size;
+                        partial.file_count++;
+                        FSM_STAT_ADD(BytesAccounted, size);
+                        if (collector_ && !it->is_symlink()) {
+                            int64_t time = candidateTime(*it);
+                            if (collector_->wants(self, time)) {
+                                collector_->offer(self, time, size, it->path().string());
+                            }
+                        }
+                    } else if (std::filesystem::is_directory(*it)) {
+                        partial.folder_count++;
+                        if (!it->is_symlink()) {
+                            subdirs.push_back({it->path()});
+                        }
+                    }
+                } catch (const std::filesystem::filesystem_error& ex) {
+                    // Ignore permission issues or other errors, continue with other files
+                    FSM_STAT_ADD(Errors, 1);
+                    logError() << "Error: " << ex.what();
+                }
+            }
+            if (ec) {
+                FSM_STAT_ADD(Errors, 1);
+                logError() << "Error: " << dir_path.string() << ": " << ec.message();
+            }
+        }
+
+        #ifdef __linux__
+        // Read the directory in large getdents64 batches; d_type saves the stat for directories and
+        // statx only asks for the fields needed, relative to the directory fd
+        void scanDirectoryRaw(const std::filesystem::path& dir_path, size_t self, std::vector<Directory>& subdirs) {
+            Partial& partial = partials_[self];
+            int dirfd = openDirectory(dir_path.native());
+            if (dirfd < 0) {
+                FSM_STAT_ADD(Errors, 1);
+                logError() << "Error: " << dir_path.native() << ": " << std::strerror(errno);
+                return;
+            }
+            FSM_STAT_ADD(DirectoriesOpened, 1);
+
+            if (partial.dirent_buffer.empty()) {
+                partial.dirent_buffer.resize(256 * 1024);
+            }
+            #ifdef FSM_IO_URING_BACKEND
+            if (uring_ && !partial.ring) {
+                partial.ring = std::make_unique<IoUringBatch>();
+            }
+            #endif
+            char* buffer = partial.dirent_buffer.data();
+
+            ScanGovernor& governor = scanGovernor();
+            while (true) {
+                governor.acquire(0, 1);
+                long length = syscall(SYS_getdents64, dirfd, buffer, partial.dirent_buffer.size());
+                if (length <= 0) {
+                    if (length < 0) {
+                        FSM_STAT_ADD(Errors, 1);
+                        logError() << "Error: " << dir_path.native() << ": " << std::strerror(errno);
+                    }
+                    break;
+                }
+
+                // Names point into the getdents buffer, so each chunk is stat'ed before the next read
+                [[maybe_unused]] size_t folders_before = partial.result.folder_count;
+                partial.stat_names.clear();
+                partial.stat_types.clear();
+                for (long offset = 0; offset < length;) {
+                    auto* entry = reinterpret_cast<const dirent64*>(buffer + offset);
+                    offset += entry->d_reclen;
+                    const char* name = entry->d_name;
+                    if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0') || std::strcmp(name, GRAVEYARD_NAME) == 0)) {
+                        continue;
+                    }
+
+                    unsigned char type = entry->d_type;
+                    if (type == DT_DIR) {
+                        partial.result.folder_count++;
+                        subdirs.push_back({dir_path.native() + '/' + name});
+                    } else if (type == DT_REG || type == DT_LNK || type == DT_UNKNOWN) {
+                        partial.stat_names.push_back(name);
+                        partial.stat_types.push_back(type);
+                    }
+                    // Devices, FIFOs and sockets do not count
+                }
+                FSM_STAT_ADD(EntriesRead, partial.result.folder_count - folders_before + partial.stat_names.size());
+                governor.acquire(partial.stat_names.size(), 0);
+                statChunk(dirfd, dir_path, self, subdirs);
+            }
+            close(dirfd);
+        }
+
+        // Links are followed like std::filesystem does (but never descended), unknown types are resolved
+        static int statFlags(unsigned char type) {
+            return AT_NO_AUTOMOUNT | AT_STATX_DONT_SYNC | (type == DT_LNK ? 0 : AT_SYMLINK_NOFOLLOW);
+        }
+
+        unsigned statMask(unsigned char type) const {
+            unsigned mask = type == DT_REG ? STATX_SIZE : STATX_TYPE | STATX_SIZE;
+            if (collector_) {
+                mask |= collector_->byAtime() ? STATX_ATIME : STATX_MTIME;
+            }
+            return mask;
+        }
+
+        // Offer a regular file (never a link target) to the eviction collector
+        void offerCandidate(const std::filesystem::path& dir_path, size_t self, const char* name, const struct statx& stx) {
+            const struct statx_timestamp& ts = collector_->byAtime() ? stx.stx_atime : stx.stx_mtime;
+            int64_t time = static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+            if (collector_->wants(self, time)) {
+                collector_->offer(self, time, stx.stx_size, dir_path.native() + '/' + name);
+            }
+        }
+
+        void statChunk(int dirfd, const std::filesystem::path& dir_path, size_t self, std::vector<Directory>& subdirs) {
+            Partial& partial = partials_[self];
+            size_t count = partial.stat_names.size();
+            partial.stat_buffers.resize(count);
+
+            #ifdef FSM_IO_URING_BACKEND
+            if (partial.ring && partial.ring->valid()) {
+                partial.stat_requests.resize(count);
+                for (size_t i = 0; i < count; i++) {
+                    unsigned char type = partial.stat_types[i];
+                    partial.stat_requests[i] = {partial.stat_names[i], statFlags(type), statMask(type), &partial.stat_buffers[i], 0};
+                }
+                partial.ring->statx(dirfd, partial.stat_requests.data(), count);
+                for (size_t i = 0; i < count; i++) {
+                    if (partial.stat_requests[i].result == 0) {
+                        accountStat(dirfd, dir_path, self, i, subdirs);
+                    }
+                }
+                return;
+            }
+            #endif
+
+            for (size_t i = 0; i < count; i++) {
+                unsigned char type = partial.stat_types[i];
+                if (statx(dirfd, partial.stat_names[i], statFlags(type), statMask(type), &partial.stat_buffers[i]) == 0) {
+                    accountStat(dirfd, dir_path, self, i, subdirs);
+                }
+            }
+        }
+
+        void accountStat(int dirfd, const std::filesystem::path& dir_path, size_t self, size_t i, std::vector<Directory>& subdirs) {
+            Partial& partial = partials_[self];
+            unsigned char type = partial.stat_types[i];
+            struct statx& stx = partial.stat_buffers[i];
+            if (type == DT_REG || S_ISREG(stx.stx_mode)) {
+                partial.result.total_size += stx.stx_size;
+                partial.result.file_count++;
+                FSM_STAT_ADD(BytesAccounted, stx.stx_size);
+                if (collector_ && type != DT_LNK) {
+                    offerCandidate(dir_path, self, partial.stat_names[i], stx);
+                }
+            } else if (S_ISDIR(stx.stx_mode)) {
+                partial.result.folder_count++;
+                if (type == DT_UNKNOWN) {
+                    subdirs.push_back({dir_path.native() + '/' + partial.stat_names[i]});
+                }
+            } else if (S_ISLNK(stx.stx_mode)) {
+                // DT_UNKNOWN that turned out to be a link: resolve it like DT_LNK
+                struct statx target{};
+                if (statx(dirfd, partial.stat_names[i], statFlags(DT_LNK), statMask(DT_LNK), &target) == 0) {
+                    if (S_ISREG(target.stx_mode)) {
+                        partial.result.total_size += target.stx_size;
+                        partial.result.file_count++;
+                        FSM_STAT_ADD(BytesAccounted, target.stx_size);
+                    } else if (S_ISDIR(target.stx_mode)) {
+                        partial.result.folder_count++;
+                    }
+                }
+            }
+        }
+        #endif
+    };
+
+#ifdef __linux__
+    // Open a directory whose path may be longer than PATH_MAX by descending through it in chunks
+    static int openDirectory(const std::string& path, int base_fd = AT_FDCWD) {
+        constexpr int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+        if (path.size() < PATH_MAX) {
+            return openat(base_fd, path.c_str(), flags);
+        }
+
+        int fd = base_fd;
+        size_t pos = 0;
+        if (path[0] == '/') {
+            fd = open("/", flags);
+            pos = path.find_first_not_of('/');
+        }
+        while (fd >= 0 && pos < path.size()) {
+            size_t end = path.size();
+            if (end - pos >= PATH_MAX) {
+                // Cut at the last separator that keeps the chunk below PATH_MAX
+                end = path.rfind('/', pos + PATH_MAX - 1);
+                if (end == std::string::npos || end <= pos) {
+                    if (fd != base_fd) {
+                        close(fd);
+                    }
+                    errno = ENAMETOOLONG;
+                    return -1;
+                }
+            }
+            int next = openat(fd, path.substr(pos, end - pos).c_str(), flags);
+            if (fd != base_fd) {
+                close(fd);
+            }
+            fd = next;
+            pos = path.find_first_not_of('/', end);
+        }
+        return fd;
+    }
+#endif
+
+    // Number of threads used for a directory walk, 0 selects a default from the hardware
+    static void setScanThreads(int thread_count) {
+        scan_threads = thread_count > 0 ? static_cast<size_t>(thread_count) : 0;
+    }
+
+    static void setScanBackend(ScanBackend backend) {
+        scan_backend = backend;
+    }
+
+    // Treat a directory whose inode, mtime and ctime are unchanged as unchanged, files included.
+    // Cheaper validation, but files written in place are only seen once their directory changes.
+    static void setTrustDirMtime(bool trust) {
+        trust_dir_mtime = trust;
+    }
+
+    // Only messages at or above this level are logged
+    static void setLogLevel(LogLevel level) {
+        logger().setLevel(level);
+    }
+
+    // Write out all pending log messages, so console prompts do not interleave with them
+    static void flushLog() {
+        logger().flush();
+    }
+
+    // Send delta-only events to a file, FIFO or "unix:/socket/path", as NDJSON or binary records.
+    // The delta is a share of the limit ("1%") or a size ("10MB").
+    static void setEventOutput(const std::string& target, bool binary, const std::string& delta) {
+        binary_events = binary;
+        if (!delta.empty() && delta.back() == '%') {
+            event_delta_ratio = std::max(0.0, std::atof(delta.c_str()) / 100.0);
+            event_delta_bytes = 0;
+        } else if (!delta.empty()) {
+            event_delta_bytes = parseSizeString(delta);
+        }
+        event_sink = std::make_unique<EventSink>(target);
+    }
+
+    // Record a timeline of scans, deletions and waits, written to path when monitoring stops
+    static void setTraceOutput(const std::string& path) {
+        trace_path = path;
+        Tracer::enable();
+    }
+
+    // Keep the size trees in an index file so that a restart does not walk every tree again
+    static void setIndexFile(const std::string& path) {
+        index_path = path;
+    }
+
+    // Log the hot-path statistics every interval_seconds (0: only when monitoring stops)
+    static void setStatsReport(int interval_seconds) {
+        #ifdef FSM_ENABLE_STATS
+        stats_report = true;
+        stats_interval_seconds = std::max(0, interval_seconds);
+        next_stats_report = std::chrono::steady_clock::now() + std::chrono::seconds(stats_interval_seconds);
+        #else
+        logWarning() << "Warning: Statistics were not compiled in (FSM_ENABLE_STATS), ignoring --stats";
+        #endif
+    }
+
+    // Serve OpenMetrics on "host:port", ":port" or "unix:/path"
+    static void setMetricsListener(const std::string& target) {
+        #ifndef _WIN32
+        metrics_server = std::make_unique<MetricsServer>(target);
+        #else
+        logWarning() << "Warning: The metrics endpoint is not available on this platform, ignoring " << target;
+        #endif
+    }
+
+    // Configure the scan governor from a specification such as "stats=20000,dirs=2000,psi=10%,io=idle"
+    static void setScanGovernor(std::string_view spec) {
+        ScanBudget budget;
+        std::string key;
+        std::string_view value;
+        while (!spec.empty()) {
+            std::string_view item = nextSetting(spec, key, value);
+            if (key == "stats") {
+                budget.stats_per_second = std::max(0.0, settingNumber(value));
+            } else if (key == "dirs") {
+                budget.dirs_per_second = std::max(0.0, settingNumber(value));
+            } else if (key == "psi") {
+                budget.psi_threshold = std::clamp(settingNumber(value), 0.0, 100.0);
+            } else if (key == "io") {
+                budget.idle_io = value == "idle";
+            } else {
+                logWarning() << "Warning: Unknown scan governor setting '" << std::string(item) << "', ignoring it";
+            }
+        }
+        scan_idle_io = budget.idle_io;
+        scanGovernor().configure(budget);
+    }
+
+    // Backend actually used for walks, Auto resolves to the fastest one the platform has
+    static ScanBackend effectiveScanBackend() {
+        #ifdef __linux__
+        // io_uring is opt-in: the kernel serves statx from its worker pool, which only pays off on cold, deep queues
+        if (scan_backend == ScanBackend::Uring) {
+            #ifdef FSM_IO_URING_BACKEND
+            if (IoUringBatch::supported()) {
+                return ScanBackend::Uring;
+            }
+            #endif
+            static bool reported = false;
+            if (!reported) {
+                logWarning() << "Warning: io_uring is not available, using the raw backend";
+                reported = true;
+            }
+            return ScanBackend::Raw;
+        }
+        return scan_backend == ScanBackend::Auto ? ScanBackend::Raw : scan_backend;
+        #else
+        return ScanBackend::Filesystem;
+        #endif
+    }
+
+    // CPUs this process may use: the affinity mask, further limited by a cgroup CPU quota
+    static size_t availableCpus() {
+        static const size_t cpus = [] {
+            size_t count = std::max(1u, std::thread::hardware_concurrency());
+            #ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+                count = std::max(1, CPU_COUNT(&set));
+            }
+
+            // cgroup v2 keeps "quota period" in cpu.max of the process's group, v1 uses two files
+            std::string group = "/";
+            std::ifstream proc_cgroup("/proc/self/cgroup");
+            std::string line;
+            while (std::getline(proc_cgroup, line)) {
+                if (line.compare(0, 3, "0::") == 0) {
+                    group = line.substr(3);
+                }
+            }
+            double quota = -1, period = 0;
+            std::ifstream cpu_max("/sys/fs/cgroup" + group + "/cpu.max");
+            if (!cpu_max.is_open()) {
+                cpu_max.open("/sys/fs/cgroup/cpu.max");
+            }
+            std::string quota_str;
+            if (cpu_max >> quota_str >> period && quota_str != "max") {
+                quota = std::atof(quota_str.c_str());
+            } else {
+                std::ifstream quota_file("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+                std::ifstream period_file("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+                if (!(quota_file >> quota && period_file >> period)) {
+                    quota = -1;
+                }
+            }
+            if (quota > 0 && period > 0) {
+                count = std::min(count, static_cast<size_t>(std::max(1.0, std::ceil(quota / period))));
+            }
+            #endif
+            return count;
+        }();
+        return cpus;
+    }
+
+    static size_t effectiveScanThreads() {
+        if (scan_threads > 0) {
+            return scan_threads;
+        }
+        return std::clamp<size_t>(availableCpus(), 1, 4);
+    }
+
+    // Checks mostly wait on I/O, so by default they run on twice the usable CPUs
+    static size_t effectiveCheckThreads() {
+        if (check_threads > 0) {
+            return check_threads;
+        }
+        return std::clamp<size_t>(availableCpus() * 2, 2, 32);
+    }
+
+#ifdef __linux__
+    struct MountPoint {
+        std::string path;
+        uint64_t device;
+        std::string fs_type;
+    };
+
+    // Mount table from /proc/self/mountinfo, so a path's device is found without touching a possibly hung mount
+    static std::vector<MountPoint> readMounts() {
+        std::vector<MountPoint> mounts;
+        std::ifstream mountinfo("/proc/self/mountinfo");
+        std::string line;
+        while (std::getline(mountinfo, line)) {
+            // "id parent major:minor root mount_point options [optional...] - fs_type source super_options"
+            std::istringstream fields(line);
+            std::string id, parent, dev, root, mount_point, field;
+            fields >> id >> parent >> dev >> root >> mount_point;
+            while (fields >> field && field != "-") {
+            }
+            std::string fs_type;
+            fields >> fs_type;
+
+            size_t colon = dev.find(':');
+            if (colon == std::string::npos || mount_point.empty()) {
+                continue;
+            }
+            // Spaces, tabs, newlines and backslashes are escaped as octal
+            std::string unescaped;
+            for (size_t i = 0; i < mount_point.size(); i++) {
+                if (mount_point[i] == '\\' && i + 3 < mount_point.size()) {
+                    unescaped += static_cast<char>(std::stoi(mount_point.substr(i + 1, 3), nullptr, 8));
+                    i += 3;
+                } else {
+                    unescaped += mount_point[i];
+                }
+            }
+            dev_t device = makedev(std::atoi(dev.substr(0, colon).c_str()), std::atoi(dev.substr(colon + 1).c_str()));
+            mounts.push_back(MountPoint{unescaped, static_cast<uint64_t>(device), fs_type});
+        }
+        return mounts;
+    }
+
+    // Remote and userspace filesystems: slow to scan and liable to hang when the server goes away
+    static bool isNetworkFilesystem(const std::string& fs_type) {
+        return fs_type.compare(0, 3, "nfs") == 0 || fs_type == "cifs" || fs_type.compare(0, 3, "smb") == 0 ||
+               fs_type.compare(0, 4, "fuse") == 0 || fs_type == "ceph" || fs_type == "9p";
+    }
+
+    // The mount a path lives on: the longest matching mount point, the latest one when stacked
+    static MountPoint findMount(const std::string& path) {
+        static std::mutex mounts_mutex;
+        static std::vector<MountPoint> mounts;
+        static std::chrono::steady_clock::time_point loaded_at;
+        std::lock_guard<std::mutex> lock(mounts_mutex);
+        auto now = std::chrono::steady_clock::now();
+        if (mounts.empty() || now - loaded_at > std::chrono::minutes(1)) {
+            mounts = readMounts();
+            loaded_at = now;
+        }
+
+        std::string normal = std::filesystem::absolute(path).lexically_normal().string();
+        const MountPoint* best = nullptr;
+        for (const MountPoint& mount : mounts) {
+            const std::string& point = mount.path;
+            bool matches = normal.compare(0, point.size(), point) == 0 &&
+                           (point == "/" || normal.size() == point.size() || normal[point.size()] == '/');
+            if (matches && (!best || point.size() >= best->path.size())) {
+                best = &mount;
+            }
+        }
+        return best ? *best : MountPoint{"/", 0, ""};
+    }
+#endif
+
+    // Device holding a configured path. On Linux it comes from the mount table, elsewhere from stat
+    // on the path or its parent when the path does not exist (yet)
+    static uint64_t deviceOf(const std::string& path) {
+        #ifdef __linux__
+        return findMount(path).device;
+        #elif !defined(_WIN32)
+        struct stat info{};
+        if (stat(path.c_str(), &info) == 0 ||
+            stat(std::filesystem::path(path).parent_path().c_str(), &info) == 0) {
+            return static_cast<uint64_t>(info.st_dev);
+        }
+        return 0;
+        #else
+        (void)path;
+        return 0;
+        #endif
+    }
+
+    // How many checks may hit the device of a path at once: few for spinning disks and network
+    // filesystems, many for SSDs and memory-backed filesystems
+    static size_t deviceConcurrency(const std::string& path) {
+        #ifdef __linux__
+        MountPoint mount = findMount(path);
+        if (isNetworkFilesystem(mount.fs_type)) {
+            return 4;
+        }
+        unsigned int dev_major = major(static_cast<dev_t>(mount.device));
+        if (dev_major == 0) {
+            // No block device behind it: tmpfs, overlay and the like
+            return 32;
+        }
+        // A partition has no queue of its own, the whole disk one level up does
+        std::string block = "/sys/dev/block/" + std::to_string(dev_major) + ":" + std::to_string(minor(static_cast<dev_t>(mount.device)));
+        std::ifstream rotational(block + "/queue/rotational");
+        if (!rotational.is_open()) {
+            rotational.open(block + "/../queue/rotational");
+        }
+        int is_rotational = 0;
+        return rotational >> is_rotational && is_rotational ? 2 : 16;
+        #else
+        (void)path;
+        return effectiveCheckThreads();
+        #endif
+    }
+
+    // Internal implementation to calculate directory size and return complete statistics
+    static DirectorySizeResult calculateDirectorySize(const std::string& dir_path) {
+        DirectorySizeResult result{0, 0, 0};
+        
+        if (!std::filesystem::exists(dir_path)) {
+            logWarning() << "Path does not exist: " << dir_path;
+            return result;
+        }
+
+        size_t thread_count = effectiveScanThreads();
+        ScanBackend backend = effectiveScanBackend();
+        if (thread_count > 1 || backend != ScanBackend::Filesystem) {
+            return ParallelDirectoryWalker(thread_count, backend).walk(dir_path);
+        }
+        
+        try {
+            auto options = std::filesystem::directory_options::none;
+                
+            ScanGovernor& governor = scanGovernor();
+            governor.acquire(0, 1);
+            FSM_STAT_ADD(DirectoriesOpened, 1);
+            for (std::filesystem::recursive_directory_iterator it(dir_path, options), end; it != end; ++it) {
+                const auto& entry = *it;
+                governor.acquire(1, 0);
+                FSM_STAT_ADD(EntriesRead, 1);
+                if (entry.path().filename() == GRAVEYARD_NAME) {
+                    it.disable_recursion_pending();
+                    continue;
+                }
+                try {
+                    if (std::filesystem::is_regular_file(entry)) {
+                        uintmax_t size = std::filesystem::file_size(entry);
+                        result.total_size += size;
+                        result.file_count++;
+                        FSM_STAT_ADD(BytesAccounted, size);
+                    } else if (std::filesystem::is_directory(entry)) {
+                        governor.acquire(0, 1);
+                        FSM_STAT_ADD(DirectoriesOpened, 1);
+                        result.folder_count++;
+                    }
+                } catch (const std::filesystem::filesystem_error& ex) {
+                    // Ignore permission issues or other errors, continue with other files
+                    FSM_STAT_ADD(Errors, 1);
+                    logError() << "Error: " << ex.what();
+                }
+            }
+        } catch (const std::filesystem::filesystem_error& ex) {
+            FSM_STAT_ADD(Errors, 1);
+            logError() << "Error: " << ex.what();
+        }
+        
+        return result;
+    }
+
+    // Token-bucket pacing of unlinks and freed bytes (GCRA: each request reserves its slot on a virtual clock).
+    // When the file system is nearly full the rates are scaled up to catch up, down to no pacing at all.
+    class DeletionPacer {
+    public:
+        DeletionPacer(const DeletionPace& pace, std::string fs_path, const std::atomic<bool>* cancel)
+            : pace_(pace), fs_path_(std::move(fs_path)), cancel_(cancel) {}
+
+        bool tracksBytes() const {
+            return pace_.bytes_per_second > 0;
+        }
+
+        // Block until the given amount of work fits into the configured rates
+        void acquire(size_t unlinks, uint64_t bytes) {
+            if (!pace_.paced()) {
+                return;
+            }
+            std::chrono::steady_clock::time_point until;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto now = std::chrono::steady_clock::now();
+                double boost = catchUpFactor(now);
+                if (boost <= 0) {
+                    return;
+                }
+                until = std::max(reserveRate(unlink_clock_, now, static_cast<double>(unlinks), pace_.unlinks_per_second * boost, BURST_SECONDS),
+                                 reserveRate(byte_clock_, now, static_cast<double>(bytes), pace_.bytes_per_second * boost, BURST_SECONDS));
+            }
+            if (until <= std::chrono::steady_clock::now()) {
+                return;
+            }
+            // Sleep in short steps so cancellation stays responsive
+            Tracer::Scope trace_scope("pacer wait");
+            while (std::chrono::steady_clock::now() < until && !(cancel_ && cancel_->load())) {
+                std::this_thread::sleep_until(std::min(until, std::chrono::steady_clock::now() + std::chrono::milliseconds(100)));
+            }
+        }
+
+    private:
+        static constexpr double BURST_SECONDS = 0.25;
+
+        DeletionPace pace_;
+        std::string fs_path_;
+        const std::atomic<bool>* cancel_;
+        std::mutex mutex_;
+        std::chrono::steady_clock::time_point unlink_clock_{};
+        std::chrono::steady_clock::time_point byte_clock_{};
+        std::chrono::steady_clock::time_point next_space_check_{};
+        double boost_ = 1.0;
+
+        // 1 while there is room, more as free space drops below the catch-up threshold, 0 = stop pacing
+        double catchUpFactor(std::chrono::steady_clock::time_point now) {
+            if (now < next_space_check_) {
+                return boost_;
+            }
+            next_space_check_ = now + std::chrono::seconds(1);
+
+            std::error_code ec;
+            auto space = std::filesystem::space(fs_path_, ec);
+            if (ec || space.capacity == 0 || pace_.catchup_free_ratio <= 0) {
+                boost_ = 1.0;
+                return boost_;
+            }
+            double free_ratio = static_cast<double>(space.available) / static_cast<double>(space.capacity);
+            if (free_ratio >= pace_.catchup_free_ratio) {
+                boost_ = 1.0;
+            } else {
+                double factor = pace_.catchup_free_ratio / std::max(free_ratio, 1e-9);
+                boost_ = factor >= 100.0 ? 0.0 : factor;
+            }
+            return boost_;
+        }
+    };
+
+    // Put the calling thread into the idle I/O scheduling class for its lifetime, then restore the old class
+    class IdleIoScope {
+    public:
+        explicit IdleIoScope(bool enable) {
+            #ifdef __linux__
+            if (enable) {
+                previous_ = static_cast<int>(syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0));
+                active_ = previous_ >= 0 && syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_IDLE) == 0;
+            }
+            #else
+            (void)enable;
+            #endif
+        }
+
+        ~IdleIoScope() {
+            #ifdef __linux__
+            if (active_) {
+                syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, previous_);
+            }
+            #endif
+        }
+
+        IdleIoScope(const IdleIoScope&) = delete;
+        IdleIoScope& operator=(const IdleIoScope&) = delete;
+
+    private:
+        #ifdef __linux__
+        static constexpr int IOPRIO_WHO_PROCESS = 1;        // "0" then means the calling thread
+        static constexpr int IOPRIO_IDLE = 3 << 13;         // IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0)
+        int previous_ = -1;
+        bool active_ = false;
+        #endif
+    };
+
+#ifdef __linux__
+    // Parallel bottom-up tree deletion: every directory is a task that unlinks its files relative to the
+    // directory fd and queues its subdirectories; the last finished child removes its parent
+    class TreeDeleter {
+    public:
+        TreeDeleter(size_t thread_count, bool use_uring, const std::atomic<bool>* cancel = nullptr,
+                    DeletionPacer* pacer = nullptr, bool idle_io = false)
+            : pool_(thread_count), workers_(pool_.threadCount()), use_uring_(use_uring), cancel_(cancel),
+              pacer_(pacer), idle_io_(idle_io) {}
+
+        // Remove everything below dir_path but keep the directory itself (inode, owner and mode stay)
+        bool emptyDirectory(const std::string& dir_path) {
+            auto root = std::make_shared<Node>();
+            root->path = dir_path;
+            pool_.run(root, [this](const std::shared_ptr<Node>& node, size_t self) {
+                // Pool threads only live for this run; the calling thread gets its class restored
+                Worker& worker = workers_[self];
+                if (!worker.io_scope) {
+                    worker.io_scope = std::make_unique<IdleIoScope>(idle_io_);
+                }
+                processDirectory(node, self);
+            });
+            workers_[0].io_scope.reset();
+            return failures_.load() == 0 && !cancelled();
+        }
+
+        size_t removedEntries() const {
+            return removed_.load();
+        }
+
+    private:
+        struct Node {
+            std::string path;
+            std::shared_ptr<Node> parent;
+            std::atomic<size_t> outstanding{1}; // Its own scan plus every unfinished subdirectory
+            int retries = 0;
+        };
+
+        struct alignas(64) Worker {
+            std::unique_ptr<IdleIoScope> io_scope;
+            std::vector<char> dirent_buffer;
+            std::vector<const char*> names;
+            #ifdef FSM_IO_URING_BACKEND
+            std::unique_ptr<IoUringBatch> ring;
+            std::vector<IoUringBatch::UnlinkRequest> requests;
+            #endif
+        };
+
+        WorkStealingPool<std::shared_ptr<Node>> pool_;
+        std::vector<Worker> workers_;
+        bool use_uring_;
+        const std::atomic<bool>* cancel_;
+        DeletionPacer* pacer_;
+        bool idle_io_;
+        std::atomic<size_t> removed_{0};
+        std::atomic<size_t> failures_{0};
+
+        bool cancelled() const {
+            return cancel_ && cancel_->load(std::memory_order_relaxed);
+        }
+
+        void processDirectory(const std::shared_ptr<Node>& node, size_t self) {
+            Tracer::Scope trace_scope("delete directory", node->path);
+            if (cancelled()) {
+                // Leave the rest on disk, unwinding only releases the tree
+                finish(node, self);
+                return;
+            }
+            Worker& worker = workers_[self];
+            int dirfd = openDirectory(node->path);
+            if (dirfd < 0) {
+                logError() << "Error: cannot open " << node->path << ": " << std::strerror(errno);
+                failures_++;
+                finish(node, self);
+                return;
+            }
+
+            if (worker.dirent_buffer.empty()) {
+                worker.dirent_buffer.resize(256 * 1024);
+            }
+            #ifdef FSM_IO_URING_BACKEND
+            if (use_uring_ && !worker.ring) {
+                worker.ring = std::make_unique<IoUringBatch>();
+            }
+            #endif
+
+            std::vector<std::shared_ptr<Node>> subdirs;
+            char* buffer = worker.dirent_buffer.data();
+            while (true) {
+                long length = syscall(SYS_getdents64, dirfd, buffer, worker.dirent_buffer.size());
+                if (length <= 0) {
+                    if (length < 0) {
+                        logError() << "Error: reading " << node->path << ": " << std::strerror(errno);
+                        failures_++;
+                    }
+                    break;
+                }
+
+                worker.names.clear();
+                for (long offset = 0; offset < length;) {
+                    auto* entry = reinterpret_cast<const dirent64*>(buffer + offset);
+                    offset += entry->d_reclen;
+                    const char* name = entry->d_name;
+                    if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                        continue;
+                    }
+
+                    bool is_dir = entry->d_type == DT_DIR;
+                    if (entry->d_type == DT_UNKNOWN) {
+                        struct stat st{};
+                        is_dir = fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+                    }
+                    if (is_dir) {
+                        auto child = std::make_shared<Node>();
+                        child->path = node->path + '/' + name;
+                        child->parent = node;
+                        subdirs.push_back(std::move(child));
+                    } else {
+                        worker.names.push_back(name);
+                    }
+                }
+                // Names point into the getdents buffer, so the chunk is unlinked before the next read
+                unlinkChunk(dirfd, node->path, worker);
+            }
+            close(dirfd);
+
+            node->outstanding.fetch_add(subdirs.size(), std::memory_order_acq_rel);
+            pool_.push(self, subdirs);
+            finish(node, self);
+        }
+
+        void unlinkChunk(int dirfd, const std::string& dir_path, Worker& worker) {
+            // Paced deletion goes in small slices so the rate stays smooth
+            size_t slice = pacer_ ? 64 : worker.names.size();
+            for (size_t begin = 0; begin < worker.names.size() && !cancelled(); begin += slice) {
+                size_t count = std::min(slice, worker.names.size() - begin);
+                const char* const* names = worker.names.data() + begin;
+                if (pacer_) {
+                    pacer_->acquire(count, pacer_->tracksBytes() ? allocatedBytes(dirfd, names, count) : 0);
+                }
+
+                #ifdef FSM_IO_URING_BACKEND
+                if (worker.ring && worker.ring->valid()) {
+                    worker.requests.resize(count);
+                    for (size_t i = 0; i < count; i++) {
+                        worker.requests[i] = {names[i], 0, 0};
+                    }
+                    worker.ring->unlink(dirfd, worker.requests.data(), count);
+                    for (size_t i = 0; i < count; i++) {
+                        countUnlink(worker.requests[i].result, dir_path, names[i]);
+                    }
+                    continue;
+                }
+                #endif
+                for (size_t i = 0; i < count; i++) {
+                    countUnlink(unlinkat(dirfd, names[i], 0) == 0 ? 0 : -errno, dir_path, names[i]);
+                }
+            }
+        }
+
+        // Space the unlinks will release, for byte pacing
+        static uint64_t allocatedBytes(int dirfd, const char* const* names, size_t count) {
+            uint64_t bytes = 0;
+            for (size_t i = 0; i < count; i++) {
+                struct statx stx{};
+                if (statx(dirfd, names[i], AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, STATX_BLOCKS, &stx) == 0) {
+                    bytes += stx.stx_blocks * 512;
+                }
+            }
+            return bytes;
+        }
+
+        void countUnlink(int result, const std::string& dir_path, const char* name) {
+            if (result == 0 || result == -ENOENT) {
+                removed_++;
+                FSM_STAT_ADD(Deletions, 1);
+            } else {
+                logError() << "Error: cannot delete " << dir_path << '/' << name << ": " << std::strerror(-result);
+                failures_++;
+                FSM_STAT_ADD(Errors, 1);
+            }
+        }
+
+        // Drop one reference; a directory whose scan and subdirectories are all done is removed,
+        // which in turn may complete its parent. The root is kept.
+        void finish(std::shared_ptr<Node> node, size_t self) {
+            while (node->outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                if (!node->parent) {
+                    return;
+                }
+                if (cancelled()) {
+                    node = node->parent;
+                    continue;
+                }
+                if (pacer_) {
+                    pacer_->acquire(1, 0);
+                }
+                if (!removeDirectory(node->path)) {
+                    if (errno == ENOTEMPTY && node->retries < 3) {
+                        // Something was created meanwhile: scan it again
+                        node->retries++;
+                        node->outstanding.store(1, std::memory_order_release);
+                        pool_.push(self, node);
+                        return;
+                    }
+                    if (errno != ENOENT) {
+                        logError() << "Error: cannot remove " << node->path << ": " << std::strerror(errno);
+                        failures_++;
+                        FSM_STAT_ADD(Errors, 1);
+                    }
+                } else {
+                    removed_++;
+                    FSM_STAT_ADD(Deletions, 1);
+                }
+                node = node->parent;
+            }
+        }
+
+        static bool removeDirectory(const std::string& path) {
+            if (path.size() < PATH_MAX) {
+                return rmdir(path.c_str()) == 0;
+            }
+            size_t slash = path.rfind('/');
+            int parent_fd = openDirectory(path.substr(0, slash));
+            if (parent_fd < 0) {
+                return false;
+            }
+            bool removed = unlinkat(parent_fd, path.c_str() + slash + 1, AT_REMOVEDIR) == 0;
+            int saved_errno = errno;
+            close(parent_fd);
+            errno = saved_errno;
+            return removed;
+        }
+    };
+#endif
+
+    // Number of threads used to delete a directory tree, 0 selects the scan default
+    static void setDeleteThreads(int thread_count) {
+        delete_threads = thread_count > 0 ? static_cast<size_t>(thread_count) : 0;
+    }
+
+    // Delete a single file in-process
+    static bool deleteFile(const std::string& file_path) {
+        Tracer::Scope trace_scope("delete file", file_path);
+        #ifdef _WIN32
+        std::filesystem::path fs_path(utf8_to_wide(file_path));
+        #else
+        std::filesystem::path fs_path(file_path);
+        #endif
+        std::error_code ec;
+        if (std::filesystem::remove(fs_path, ec)) {
+            FSM_STAT_ADD(Deletions, 1);
+            logInfo() << "Successfully deleted file: " << file_path;
+            return true;
+        }
+        FSM_STAT_ADD(Errors, 1);
+        logError() << "Failed to delete file: " << file_path << " (" << (ec ? ec.message() : "not found") << ")";
+        return false;
+    }
+
+    // Delete everything inside a directory in-process; the directory itself is kept
+    static bool emptyDirectory(const std::string& dir_path, const std::atomic<bool>* cancel = nullptr,
+                               const DeletionPace* pace_config = nullptr) {
+        Tracer::Scope trace_scope("empty directory", dir_path);
+        const DeletionPace pace = pace_config ? *pace_config : DeletionPace();
+        #ifdef _WIN32
+        std::filesystem::path fs_path(utf8_to_wide(dir_path));
+        #else
+        std::filesystem::path fs_path(dir_path);
+        #endif
+        std::error_code ec;
+        if (!std::filesystem::is_directory(fs_path, ec)) {
+            logError() << "Failed to empty directory, not a directory: " << dir_path;
+            return false;
+        }
+
+        DeletionPacer pacer(pace, dir_path, cancel);
+        #ifdef __linux__
+        TreeDeleter deleter(delete_threads > 0 ? delete_threads : effectiveScanThreads(),
+                            effectiveScanBackend() == ScanBackend::Uring, cancel,
+                            pace.paced() ? &pacer : nullptr, pace.idle_io);
+        bool success = deleter.emptyDirectory(dir_path);
+        size_t removed = deleter.removedEntries();
+        #else
+        IdleIoScope io_scope(pace.idle_io);
+        bool success = true;
+        size_t removed = 0;
+        for (std::filesystem::directory_iterator it(fs_path, ec), end; !ec && it != end; it.increment(ec)) {
+            if (cancel && cancel->load()) {
+                success = false;
+                break;
+            }
+            std::error_code remove_ec;
+            auto count = std::filesystem::remove_all(it->path(), remove_ec);
+            if (remove_ec) {
+                FSM_STAT_ADD(Errors, 1);
+                logError() << "Failed to delete: " << it->path().string() << " (" << remove_ec.message() << ")";
+                success = false;
+            } else {
+                removed += static_cast<size_t>(count);
+                FSM_STAT_ADD(Deletions, count);
+                pacer.acquire(static_cast<size_t>(count), 0);
+            }
+        }
+        if (ec) {
+            success = false;
+        }
+        #endif
+
+        if (success) {
+            logInfo() << "Successfully emptied directory: " << dir_path << " (" << removed << " entries removed)";
+        } else {
+            logWarning() << "Directory only partially emptied: " << dir_path << " (" << removed << " entries removed)";
+        }
+        return success;
+    }
+
+    // Name of the hidden directory, at the root of a file system, that holds victims until they are reclaimed.
+    // Walks and watches skip it: its contents are on their way out and must not count toward any entry.
+    static constexpr const char* GRAVEYARD_NAME = ".filesizemgr-graveyard";
+
+    // Directories that can hold the graveyard of a victim, from the root of its file system down to its parent
+    static std::vector<std::filesystem::path> graveyardHomes(const std::filesystem::path& target) {
+        std::vector<std::filesystem::path> homes;
+        std::error_code ec;
+        std::filesystem::path parent = std::filesystem::absolute(target, ec).parent_path();
+        if (ec) {
+            return homes;
+        }
+        #ifndef _WIN32
+        struct stat parent_stat{};
+        if (stat(parent.c_str(), &parent_stat) != 0) {
+            return homes;
+        }
+        #endif
+        for (std::filesystem::path dir = parent; !dir.empty(); dir = dir.parent_path()) {
+            #ifndef _WIN32
+            struct stat dir_stat{};
+            if (stat(dir.c_str(), &dir_stat) != 0 || dir_stat.st_dev != parent_stat.st_dev) {
+                break;
+            }
+            #endif
+            homes.push_back(dir);
+            if (dir == dir.parent_path()) {
+                break;
+            }
+        }
+        std::reverse(homes.begin(), homes.end());
+        return homes;
+    }
+
+    // Background reclamation queue: trash renames victims into a graveyard on the monitoring thread
+    // (O(1)) and this worker deletes them. Whatever is left in a graveyard is picked up on next startup.
+    class TrashQueue {
+    public:
+        struct Job {
+            std::string description;
+            std::function<void(const std::atomic<bool>& cancel)> work;
+        };
+
+        ~TrashQueue() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+                cancel_ = true;
+            }
+            wakeup_.notify_all();
+            if (worker_.joinable()) {
+                worker_.join();
+            }
+        }
+
+        void enqueue(Job job) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stopping_) {
+                    return;
+                }
+                jobs_.push_back(std::move(job));
+                if (!worker_.joinable()) {
+                    worker_ = std::thread(&TrashQueue::workerLoop, this);
+                }
+            }
+            wakeup_.notify_one();
+        }
+
+        size_t pendingJobs() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return jobs_.size() + (busy_ ? 1 : 0);
+        }
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable wakeup_;
+        std::deque<Job> jobs_;
+        std::thread worker_;
+        std::atomic<bool> cancel_{false};
+        bool stopping_ = false;
+        bool busy_ = false;
+
+        void workerLoop() {
+            Tracer::nameThread("trash worker");
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true) {
+                wakeup_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+                if (stopping_) {
+                    return;
+                }
+                Job job = std::move(jobs_.front());
+                jobs_.pop_front();
+                busy_ = true;
+                lock.unlock();
+
+                job.work(cancel_);
+
+                lock.lock();
+                busy_ = false;
+            }
+        }
+    };
+
+#ifdef FSM_BENCHMARK
+    // Observation points of the churn simulator (benchmark.cpp)
+    static inline std::function<void(const std::string& path)> bench_on_oversize;
+    static inline std::function<void(const std::filesystem::path& victim)> bench_on_reclaimed;
+#endif
+
+    static TrashQueue& trashQueue() {
+        static TrashQueue queue;
+        return queue;
+    }
+
+    // Delete a victim from a graveyard completely, then the graveyard itself once it is empty
+    static void reclaimVictim(const std::filesystem::path& victim, const std::atomic<bool>& cancel,
+                              const DeletionPace* pace = nullptr) {
+        Tracer::Scope trace_scope("reclaim", victim);
+        std::error_code ec;
+        if (std::filesystem::is_directory(std::filesystem::symlink_status(victim, ec))) {
+            if (!emptyDirectory(victim.string(), &cancel, pace)) {
+                return; // Interrupted or failed: left for the next startup
+            }
+        }
+        std::filesystem::remove(victim, ec);
+        if (ec) {
+            logError() << "Failed to reclaim " << victim.string() << ": " << ec.message();
+            return;
+        }
+        logInfo() << "Reclaimed trashed directory: " << victim.string();
+        #ifdef FSM_BENCHMARK
+        if (bench_on_reclaimed) {
+            bench_on_reclaimed(victim);
+        }
+        #endif
+        std::filesystem::remove(victim.parent_path(), ec); // Fails harmlessly while other victims remain
+    }
+
+    // Move a directory into the graveyard of its file system and put an empty directory with the same mode and
+    // owner in its place. The graveyard goes as high up as it can be created, preferably the root of the file
+    // system, so it does not sit inside the monitored directories. Returns false if the rename is not possible.
+    static bool moveToGraveyard(const std::string& dir_path, std::filesystem::path& victim) {
+        #ifdef _WIN32
+        std::filesystem::path target(utf8_to_wide(dir_path));
+        #else
+        std::filesystem::path target(dir_path);
+        #endif
+        target = target.lexically_normal();
+        if (!target.has_filename()) {
+            target = target.parent_path();
+        }
+
+        std::error_code ec;
+        auto permissions = std::filesystem::status(target, ec).permissions();
+        if (ec) {
+            return false;
+        }
+        #ifndef _WIN32
+        struct stat target_stat{};
+        struct stat parent_stat{};
+        if (stat(target.c_str(), &target_stat) != 0 || stat(target.parent_path().c_str(), &parent_stat) != 0 ||
+            target_stat.st_dev != parent_stat.st_dev) {
+            return false; // A mount point cannot be renamed away
+        }
+        #endif
+
+        static std::atomic<unsigned> sequence{0};
+        auto stamp = std::chrono::system_clock::now().time_since_epoch().count();
+        std::string victim_name = target.filename().string() + "." + std::to_string(stamp) + "." + std::to_string(sequence++);
+
+        bool moved = false;
+        for (const auto& home : graveyardHomes(target)) {
+            std::filesystem::path graveyard = home / GRAVEYARD_NAME;
+            bool created = std::filesystem::create_directory(graveyard, ec);
+            if (ec) {
+                continue; // Not writable here, try closer to the victim
+            }
+            victim = graveyard / victim_name;
+            std::filesystem::rename(target, victim, ec);
+            if (!ec) {
+                moved = true;
+                break;
+            }
+            if (created) {
+                std::filesystem::remove(graveyard, ec);
+            }
+        }
+        if (!moved) {
+            return false;
+        }
+
+        std::filesystem::create_directory(target, ec);
+        if (ec) {
+            logError() << "Failed to recreate empty directory at: " << dir_path << " (" << ec.message() << ")";
+            return true; // The victim is in the graveyard either way
+        }
+        std::filesystem::permissions(target, permissions, ec);
+        #ifndef _WIN32
+        if (chown(target.c_str(), target_stat.st_uid, target_stat.st_gid) != 0 && errno != EPERM) {
+            logWarning() << "Warning: cannot restore owner of " << dir_path << ": " << std::strerror(errno);
+        }
+        #endif
+        return true;
+    }
+
+    // Trash a directory without blocking: rename into the graveyard and reclaim in the background,
+    // or empty it in place on the background worker when it cannot be renamed
+    static bool trashDirectory(const std::string& dir_path, const DeletionPace& pace) {
+        Tracer::Scope trace_scope("trash directory", dir_path);
+        std::filesystem::path victim;
+        if (moveToGraveyard(dir_path, victim)) {
+            logInfo() << "Moved directory contents to graveyard: " << victim.string();
+            trashQueue().enqueue({victim.string(), [victim, pace](const std::atomic<bool>& cancel) { reclaimVictim(victim, cancel, &pace); }});
+            return true;
+        }
+
+        std::error_code ec;
+        if (!std::filesystem::is_directory(dir_path, ec)) {
+            logError() << "Failed to trash, not a directory: " << dir_path;
+            return false;
+        }
+        logInfo() << "Cannot rename " << dir_path << " into a graveyard, emptying it in place in the background";
+        trashQueue().enqueue({dir_path, [dir_path, pace](const std::atomic<bool>& cancel) { emptyDirectory(dir_path, &cancel, &pace); }});
+        return true;
+    }
+
+    // Queue the leftovers of graveyards that an earlier run did not finish
+    void recoverGraveyards() {
+        std::set<std::filesystem::path> graveyards;
+        for (const auto& config : file_configs) {
+            if (config.type != "path") {
+                continue;
+            }
+            std::filesystem::path target = std::filesystem::path(config.path).lexically_normal();
+            if (!target.has_filename()) {
+                target = target.parent_path();
+            }
+            for (const auto& home : graveyardHomes(target)) {
+                graveyards.insert(home / GRAVEYARD_NAME);
+            }
+        }
+
+        for (const auto& graveyard : graveyards) {
+            std::error_code ec;
+            for (std::filesystem::directory_iterator it(graveyard, ec), end; !ec && it != end; it.increment(ec)) {
+                std::filesystem::path victim = it->path();
+                logInfo() << "Resuming reclamation of: " << victim.string();
+                trashQueue().enqueue({victim.string(), [victim](const std::atomic<bool>& cancel) { reclaimVictim(victim, cancel); }});
+            }
+        }
+    }
+
+    // Delete the oldest files of a directory until its size is below the low watermark. Each pass walks the tree
+    // once, measuring it and keeping only the oldest EVICTION_CANDIDATES files; more passes follow if needed.
+    static void evictOldest(const std::string& dir_path, double low_watermark, bool by_atime,
+                            const DeletionPace& pace, const std::atomic<bool>& cancel) {
+        Tracer::Scope trace_scope("evict", dir_path);
+        IdleIoScope io_scope(pace.idle_io);
+        DeletionPacer pacer(pace, dir_path, &cancel);
+        size_t deleted = 0;
+        uintmax_t freed = 0;
+
+        for (int pass = 0; pass < 16 && !cancel.load(); pass++) {
+            EvictionCollector collector(EVICTION_CANDIDATES, by_atime);
+            DirectorySizeResult result = ParallelDirectoryWalker(effectiveScanThreads(), effectiveScanBackend()).walk(dir_path, &collector);
+            if (static_cast<double>(result.total_size) <= low_watermark) {
+                break;
+            }
+
+            auto need = static_cast<uintmax_t>(static_cast<double>(result.total_size) - low_watermark);
+            uintmax_t pass_freed = 0;
+            std::vector<EvictionCollector::Candidate> candidates = collector.takeOldest();
+            for (const auto& candidate : candidates) {
+                if (cancel.load() || pass_freed >= need) {
+                    break;
+                }
+                if (!stillEvictable(candidate, by_atime)) {
+                    continue; // Used or replaced since the walk
+                }
+                pacer.acquire(1, candidate.size);
+                std::error_code ec;
+                if (std::filesystem::remove(candidate.path, ec)) {
+                    pass_freed += candidate.size;
+                    deleted++;
+                    FSM_STAT_ADD(Deletions, 1);
+                } else if (ec) {
+                    FSM_STAT_ADD(Errors, 1);
+                    logError() << "Failed to evict " << candidate.path << ": " << ec.message();
+                }
+            }
+            freed += pass_freed;
+
+            // A pass that saw every file, or could not free anything, will not do better next time
+            if (pass_freed >= need || candidates.size() < collector.limit() || pass_freed == 0) {
+                break;
+            }
+        }
+
+        logInfo() << "Evicted " << deleted << " files (" << formatFileSize(static_cast<double>(freed))
+                  << ") from: " << dir_path;
+    }
+
+    // A candidate is only deleted if its time stamp did not move since it was collected
+    static bool stillEvictable(const EvictionCollector::Candidate& candidate, bool by_atime) {
+        #ifdef _WIN32
+        (void)by_atime;
+        std::error_code ec;
+        return std::filesystem::is_regular_file(std::filesystem::symlink_status(candidate.path, ec)) &&
+               static_cast<int64_t>(std::filesystem::last_write_time(candidate.path, ec).time_since_epoch().count()) <= candidate.time;
+        #else
+        struct stat st{};
+        if (lstat(candidate.path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            return false;
+        }
+        const struct timespec& ts = by_atime ? st.st_atim : st.st_mtim;
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec <= candidate.time;
+        #endif
+    }
+
+    // Values exported over OpenMetrics. Checks update it after each round, a scrape only renders what is
+    // stored here and never touches the filesystem.
+    class MetricsRegistry {
+    public:
+        enum class Action {
+            Trash,
+            Warn,
+            Evict
+        };
+
+        // Follow a reload of the configuration, dropping the entries it removed
+        void renumberEntries(const std::vector<size_t>& new_ids, size_t id_count) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::vector<EntryValues> entries(id_count);
+            for (size_t i = 0; i < entries_.size() && i < new_ids.size(); i++) {
+                if (new_ids[i] != NO_ENTRY) {
+                    entries[new_ids[i]] = std::move(entries_[i]);
+                }
+            }
+            entries_.swap(entries);
+        }
+
+        void recordEntry(size_t index, const FileConfig& config, const Measurement& measurement) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (index >= entries_.size()) {
+                entries_.resize(index + 1);
+            }
+            bool missing = config.type == "path" ? measurement.size <= 0 : measurement.size < 0;
+            entries_[index] = EntryValues{config.path, config.type, config.max_size_bytes, measurement.size,
+                                          measurement.file_count, measurement.folder_count, !missing};
+
+            // Bucket counts are cumulative only when rendered
+            size_t bucket = 0;
+            while (bucket < SCAN_BUCKETS.size() && measurement.seconds > SCAN_BUCKETS[bucket]) {
+                bucket++;
+            }
+            scan_buckets_[bucket]++;
+            scan_seconds_sum_ += measurement.seconds;
+            scan_count_++;
+        }
+
+        // Throughput of a whole round
+        void recordRound(size_t entries, double seconds) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            entries_scanned_ += entries;
+            entries_per_second_ = seconds > 0 ? static_cast<double>(entries) / seconds : 0;
+        }
+
+        void countAction(Action action) {
+            actions_[static_cast<size_t>(action)].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void countSyscalls(size_t stats, size_t dir_reads) {
+            stat_calls_.fetch_add(stats, std::memory_order_relaxed);
+            dir_reads_.fetch_add(dir_reads, std::memory_order_relaxed);
+        }
+
+        uint64_t statCalls() const {
+            return stat_calls_.load(std::memory_order_relaxed);
+        }
+
+        uint64_t dirReads() const {
+            return dir_reads_.load(std::memory_order_relaxed);
+        }
+
+        std::string render() const {
+            std::string out;
+            std::lock_guard<std::mutex> lock(mutex_);
+            family(out, "fsm_entry_bytes", "gauge", "Current size of a configured entry", "bytes");
+            for (const EntryValues& entry : entries_) {
+                if (entry.present) {
+                    sample(out, "fsm_entry_bytes", entry, entry.bytes);
+                }
+            }
+            family(out, "fsm_entry_limit_bytes", "gauge", "Size threshold of a configured entry", "bytes");
+            for (const EntryValues& entry : entries_) {
+                if (!entry.path.empty()) {
+                    sample(out, "fsm_entry_limit_bytes", entry, entry.limit);
+                }
+            }
+            family(out, "fsm_entry_files", "gauge", "Regular files in a configured entry", "");
+            for (const EntryValues& entry : entries_) {
+                if (entry.present) {
+                    sample(out, "fsm_entry_files", entry, static_cast<double>(entry.files));
+                }
+            }
+            family(out, "fsm_entry_folders", "gauge", "Subdirectories in a configured entry", "");
+            for (const EntryValues& entry : entries_) {
+                if (entry.present) {
+                    sample(out, "fsm_entry_folders", entry, static_cast<double>(entry.folders));
+                }
+            }
+
+            family(out, "fsm_scan_duration_seconds", "histogram", "Time to measure one entry", "seconds");
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i <= SCAN_BUCKETS.size(); i++) {
+                cumulative += scan_buckets_[i];
+                out += "fsm_scan_duration_seconds_bucket{le=\"";
+                out += i < SCAN_BUCKETS.size() ? formatNumber(SCAN_BUCKETS[i]) : std::string("+Inf");
+                out += "\"} " + std::to_string(cumulative) + "\n";
+            }
+            out += "fsm_scan_duration_seconds_sum " + formatNumber(scan_seconds_sum_) + "\n";
+            out += "fsm_scan_duration_seconds_count " + std::to_string(scan_count_) + "\n";
+
+            family(out, "fsm_entries_scanned", "counter", "Entries measured", "");
+            out += "fsm_entries_scanned_total " + std::to_string(entries_scanned_) + "\n";
+            family(out, "fsm_entries_per_second", "gauge", "Entries measured per second in the last round", "");
+            out += "fsm_entries_per_second " + formatNumber(entries_per_second_) + "\n";
+            family(out, "fsm_stat_calls", "counter", "stat calls issued by scans", "");
+            out += "fsm_stat_calls_total " + std::to_string(stat_calls_.load()) + "\n";
+            family(out, "fsm_directory_reads", "counter", "Directory read calls issued by scans", "");
+            out += "fsm_directory_reads_total " + std::to_string(dir_reads_.load()) + "\n";
+            family(out, "fsm_actions", "counter", "Actions taken on oversized entries", "");
+            const char* names[] = {"trash", "warn", "evict"};
+            for (size_t i = 0; i < 3; i++) {
+                out += "fsm_actions_total{action=\"" + std::string(names[i]) + "\"} " + std::to_string(actions_[i].load()) + "\n";
+            }
+            out += "# EOF\n";
+            return out;
+        }
+
+    private:
+        struct EntryValues {
+            std::string path;
+            std::string type;
+            double limit = 0;
+            double bytes = 0;
+            size_t files = 0;
+            size_t folders = 0;
+            bool present = false;
+        };
+
+        static constexpr std::array<double, 12> SCAN_BUCKETS{0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 10, 30, 60, 300};
+
+        mutable std::mutex mutex_;
+        std::vector<EntryValues> entries_;
+        std::array<uint64_t, SCAN_BUCKETS.size() + 1> scan_buckets_{};
+        double scan_seconds_sum_ = 0;
+        uint64_t scan_count_ = 0;
+        uint64_t entries_scanned_ = 0;
+        double entries_per_second_ = 0;
+        std::atomic<uint64_t> stat_calls_{0};
+        std::atomic<uint64_t> dir_reads_{0};
+        std::array<std::atomic<uint64_t>, 3> actions_{};
+
+        static std::string formatNumber(double value) {
+            char buffer[32];
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+            return std::string(buffer, result.ptr);
+        }
+
+        static void family(std::string& out, const char* name, const char* type, const char* help, const char* unit) {
+            out += "# TYPE " + std::string(name) + " " + type + "\n";
+            if (unit[0] != '\0') {
+                out += "# UNIT " + std::string(name) + " " + unit + "\n";
+            }
+            out += "# HELP " + std::string(name) + " " + help + "\n";
+        }
+
+        static void sample(std::string& out, const char* name, const EntryValues& entry, double value) {
+            out += name;
+            out += "{path=\"";
+            for (char c : entry.path) {
+                if (c == '\\' || c == '"') {
+                    out += '\\';
+                    out += c;
+                } else if (c == '\n') {
+                    out += "\\n";
+                } else {
+                    out += c;
+                }
+            }
+            out += "\",type=\"" + entry.type + "\"} " + formatNumber(value) + "\n";
+        }
+    };
+
+    static MetricsRegistry& metrics() {
+        static MetricsRegistry registry;
+        return registry;
+    }
+
+#ifndef _WIN32
+    // Minimal HTTP listener for scrapes on "host:port", ":port" or "unix:/path"; answers GET /metrics
+    class MetricsServer {
+    public:
+        explicit MetricsServer(const std::string& target) {
+            if (target.compare(0, 5, "unix:") == 0) {
+                sockaddr_un address{};
+                address.sun_family = AF_UNIX;
+                std::string path = target.substr(5);
+                if (path.size() < sizeof(address.sun_path)) {
+                    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+                    unlink(path.c_str());
+                    fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                    if (fd_ >= 0 && bind(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+                        closeListener();
+                    }
+                }
+            } else {
+                size_t colon = target.rfind(':');
+                std::string host = colon == std::string::npos ? std::string() : target.substr(0, colon);
+                int port = std::atoi(target.c_str() + (colon == std::string::npos ? 0 : colon + 1));
+                sockaddr_in address{};
+                address.sin_family = AF_INET;
+                address.sin_port = htons(static_cast<uint16_t>(port));
+                // Only the local machine by default; give an address to listen elsewhere
+                if (inet_pton(AF_INET, host.empty() ? "127.0.0.1" : host.c_str(), &address.sin_addr) == 1) {
+                    fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                    int reuse = 1;
+                    if (fd_ >= 0) {
+                        setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+                    }
+                    if (fd_ >= 0 && bind(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+                        closeListener();
+                    }
+                }
+            }
+            if (fd_ < 0 || listen(fd_, 16) != 0) {
+                logError() << "Error: Cannot listen for metrics on " << target << ": " << std::strerror(errno);
+                closeListener();
+                return;
+            }
+            logInfo() << "Serving metrics on " << target;
+            thread_ = std::thread([this] { serve(); });
+        }
+
+        ~MetricsServer() {
+            stop_.store(true);
+            if (fd_ >= 0) {
+                shutdown(fd_, SHUT_RDWR);
+            }
+            if (thread_.joinable()) {
+                thread_.join();
+            }
+            closeListener();
+        }
+
+        MetricsServer(const MetricsServer&) = delete;
+        MetricsServer& operator=(const MetricsServer&) = delete;
+
+    private:
+        int fd_ = -1;
+        std::atomic<bool> stop_{false};
+        std::thread thread_;
+
+        void closeListener() {
+            if (fd_ >= 0) {
+                close(fd_);
+                fd_ = -1;
+            }
+        }
+
+        // One scrape at a time is plenty; a slow client only gets a few seconds
+        void serve() {
+            while (!stop_.load()) {
+                int client = accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+                if (client < 0) {
+                    if (errno == EINTR || errno == ECONNABORTED) {
+                        continue;
+                    }
+                    return;
+                }
+                timeval timeout{5, 0};
+                setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+                std::string request;
+                char buffer[1024];
+                while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+                    ssize_t length = recv(client, buffer, sizeof(buffer), 0);
+                    if (length <= 0) {
+                        break;
+                    }
+                    request.append(buffer, static_cast<size_t>(length));
+                }
+
+                std::string response;
+                if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0) {
+                    std::string body = metrics().render();
+                    response = "HTTP/1.1 200 OK\r\nContent-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                               "Content-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+                } else {
+                    response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+                }
+                size_t offset = 0;
+                while (offset < response.size()) {
+                    ssize_t written = send(client, response.data() + offset, response.size() - offset, MSG_NOSIGNAL);
+                    if (written <= 0) {
+                        break;
+                    }
+                    offset += static_cast<size_t>(written);
+                }
+                close(client);
+            }
+        }
+    };
+
+    static inline std::unique_ptr<MetricsServer> metrics_server;
+#endif
+
+    static inline std::string trace_path;
+    static inline std::string index_path;
+    static constexpr int INDEX_SAVE_SECONDS = 300;
+    ScanIndex::Trees indexed_trees;   // Loaded at start, handed to their entries on the first watch
+    std::chrono::steady_clock::time_point next_index_save;
+
+    void loadIndex() {
+        if (index_path.empty()) {
+            return;
+        }
+        indexed_trees = ScanIndex::load(index_path);
+        if (!indexed_trees.empty()) {
+            logInfo() << "Loaded scan index " << index_path << " with " << indexed_trees.size() << " trees";
+        }
+        // The first save follows soon, so a crash shortly after a cold start still leaves an index
+        next_index_save = std::chrono::steady_clock::now() + std::chrono::seconds(check_interval_seconds);
+    }
+
+    static ConfigSignature configSignature(const std::string& path) {
+        std::error_code ec;
+        auto mtime = std::filesystem::last_write_time(path, ec);
+        if (ec) {
+            return {};
+        }
+        uintmax_t size = std::filesystem::file_size(path, ec);
+        if (ec) {
+            return {};
+        }
+        return {true, static_cast<int64_t>(mtime.time_since_epoch().count()), size};
+    }
+
+    static bool sameSettings(const FileConfig& a, const FileConfig& b) {
+        return a.max_size_bytes == b.max_size_bytes && a.original_size_str == b.original_size_str && a.action == b.action &&
+               a.pace == b.pace && a.low_watermark_bytes == b.low_watermark_bytes &&
+               a.evict_by_atime == b.evict_by_atime && a.interval_seconds == b.interval_seconds;
+    }
+
+    static std::set<size_t> renumberSet(const std::set<size_t>& indices, const std::vector<size_t>& new_ids) {
+        std::set<size_t> renumbered;
+        for (size_t index : indices) {
+            if (index < new_ids.size() && new_ids[index] != NO_ENTRY) {
+                renumbered.insert(new_ids[index]);
+            }
+        }
+        return renumbered;
+    }
+
+    // Reload the TSV once it changed and then stayed the same for one poll (so a file still being
+    // written is not read), keeping measurements, trees, warnings and schedules of unchanged entries.
+    // pending holds entry indices of the caller and is renumbered along with the monitor's own.
+    void reloadConfigIfChanged(std::set<size_t>& pending) {
+        if (config_path.empty()) {
+            return;
+        }
+        ConfigSignature signature = configSignature(config_path);
+        if (signature == config_signature) {
+            pending_signature = signature;
+            return;
+        }
+        if (!(signature == pending_signature)) {
+            pending_signature = signature;
+            return;
+        }
+        config_signature = signature;
+
+        std::vector<FileConfig> loaded;
+        if (!signature.exists || !parseConfig(config_path, loaded) || loaded.empty()) {
+            logWarning() << "Warning: Reloading " << config_path << " failed, keeping the current configuration";
+            return;
+        }
+
+        // Match by path and type; an entry listed twice matches its old copies in order
+        std::unordered_map<std::string, std::deque<size_t>> previous;
+        for (size_t i = 0; i < file_configs.size(); i++) {
+            previous[file_configs[i].type + '\t' + file_configs[i].path].push_back(i);
+        }
+        std::vector<size_t> new_ids(file_configs.size(), NO_ENTRY);
+        std::vector<size_t> added;
+        std::set<size_t> changed;
+        for (size_t i = 0; i < loaded.size(); i++) {
+            auto it = previous.find(loaded[i].type + '\t' + loaded[i].path);
+            if (it == previous.end() || it->second.empty()) {
+                added.push_back(i);
+                continue;
+            }
+            size_t old_index = it->second.front();
+            it->second.pop_front();
+            new_ids[old_index] = i;
+            FileConfig& current = file_configs[old_index];
+            if (!sameSettings(current, loaded[i])) {
+                // Keep the scan state, take the new settings and evaluate them right away
+                bool threshold_changed = current.max_size_bytes != loaded[i].max_size_bytes || current.action != loaded[i].action;
+                current.max_size_bytes = loaded[i].max_size_bytes;
+                current.original_size_str = loaded[i].original_size_str;
+                current.action = loaded[i].action;
+                current.pace = loaded[i].pace;
+                current.low_watermark_bytes = loaded[i].low_watermark_bytes;
+                current.evict_by_atime = loaded[i].evict_by_atime;
+                current.interval_seconds = loaded[i].interval_seconds;
+                if (threshold_changed) {
+                    current.has_warned = false;
+                }
+                changed.insert(i);
+            }
+            loaded[i] = std::move(current);
+        }
+        size_t removed = std::count(new_ids.begin(), new_ids.end(), NO_ENTRY);
+
+#ifdef __linux__
+        if (inotify_fd >= 0) {
+            for (size_t i = 0; i < new_ids.size(); i++) {
+                if (new_ids[i] == NO_ENTRY) {
+                    unwatchEntry(i);
+                }
+            }
+            for (auto& [wd, info] : watches) {
+                for (size_t& owner : info.path_owners) {
+                    owner = new_ids[owner];
+                }
+                for (auto& owner : info.file_owners) {
+                    owner.first = new_ids[owner.first];
+                }
+            }
+        }
+        std::vector<bool> polled(loaded.size(), false);
+        for (size_t i = 0; i < new_ids.size() && i < polled_entries.size(); i++) {
+            if (new_ids[i] != NO_ENTRY) {
+                polled[new_ids[i]] = polled_entries[i];
+            }
+        }
+        polled_entries.swap(polled);
+        rewatch_entries = renumberSet(rewatch_entries, new_ids);
+#endif
+
+        file_configs.swap(loaded);
+        check_timers.renumber(new_ids, file_configs.size());
+        metrics().renumberEntries(new_ids, file_configs.size());
+        pending = renumberSet(pending, new_ids);
+        deferred_entries = renumberSet(deferred_entries, new_ids);
+        std::deque<size_t> warmup;
+        for (size_t index : warmup_entries) {
+            if (new_ids[index] != NO_ENTRY) {
+                warmup.push_back(new_ids[index]);
+            }
+        }
+        warmup_entries.swap(warmup);
+
+        for (size_t index : added) {
+            bool watched = false;
+#ifdef __linux__
+            if (inotify_fd >= 0) {
+                rewatchEntry(index);
+                watched = true;
+            }
+#endif
+            if (!watched && file_configs[index].type == "path") {
+                attachSizeTree(file_configs[index], true);
+            }
+            warmup_entries.push_back(index);
+        }
+        for (size_t index : changed) {
+            check_timers.schedule(index, 1);
+            pending.insert(index);
+        }
+
+        logInfo() << "Reloaded " << config_path << ": " << added.size() << " added, " << removed << " removed, "
+                  << changed.size() << " changed, " << file_configs.size() - added.size() - changed.size() << " unchanged";
+    }
+
+    // New entries are measured a few per loop iteration, so a large addition does not stall regular checks
+    std::set<size_t> takeWarmupEntries() {
+        std::set<size_t> batch;
+        size_t limit = std::max<size_t>(1, effectiveCheckThreads());
+        while (!warmup_entries.empty() && batch.size() < limit) {
+            batch.insert(warmup_entries.front());
+            warmup_entries.pop_front();
+        }
+        return batch;
+    }
+
+    // Give a PATH entry its size tree: the indexed one if there is one, else its current or a new one.
+    // The next measurement re-lists only directories that changed; a tree never built is walked in full.
+    // An indexed tree reports its saved totals right away and is validated a slice per check.
+    void attachSizeTree(FileConfig& config, bool validate_always) {
+        config.validate_tree = validate_always;
+        auto indexed = indexed_trees.find(config.path);
+        if (indexed != indexed_trees.end()) {
+            config.size_tree = std::move(indexed->second);
+            indexed_trees.erase(indexed);
+            config.size_tree->revalidateInSlices();
+            return;
+        }
+        if (!config.size_tree) {
+            config.size_tree = std::make_shared<DirectorySizeTree>(config.path);
+        }
+        config.size_tree->revalidate();
+    }
+
+    // Write the index between rounds, when no check worker is updating a tree
+    void maybeSaveIndex(bool force) {
+        if (index_path.empty() || (!force && std::chrono::steady_clock::now() < next_index_save)) {
+            return;
+        }
+        next_index_save = std::chrono::steady_clock::now() + std::chrono::seconds(INDEX_SAVE_SECONDS);
+        std::vector<std::shared_ptr<DirectorySizeTree>> trees;
+        for (const auto& config : file_configs) {
+            if (config.size_tree) {
+                trees.push_back(config.size_tree);
+            }
+        }
+        if (!trees.empty()) {
+            ScanIndex::save(index_path, trees);
+        }
+    }
+
+#ifdef FSM_ENABLE_STATS
+    static inline bool stats_report = false;
+    static inline int stats_interval_seconds = 60;
+    static inline std::chrono::steady_clock::time_point next_stats_report;
+
+    static std::string formatDuration(uint64_t nanoseconds) {
+        if (nanoseconds < 1000) {
+            return std::to_string(nanoseconds) + "ns";
+        }
+        if (nanoseconds < 1000000) {
+            return formatFixed(static_cast<double>(nanoseconds) / 1e3, 1) + "us";
+        }
+        if (nanoseconds < 1000000000) {
+            return formatFixed(static_cast<double>(nanoseconds) / 1e6, 1) + "ms";
+        }
+        return formatFixed(static_cast<double>(nanoseconds) / 1e9, 2) + "s";
+    }
+#endif
+
+    // Periodic summary of the hot-path statistics, or the final one when monitoring stops
+    static void reportStats(bool final) {
+        #ifdef FSM_ENABLE_STATS
+        auto now = std::chrono::steady_clock::now();
+        if (!stats_report || (!final && (stats_interval_seconds == 0 || now < next_stats_report))) {
+            return;
+        }
+        next_stats_report = now + std::chrono::seconds(stats_interval_seconds);
+
+        auto snapshot = std::make_unique<HotStats::Snapshot>();
+        HotStats::snapshot(*snapshot);
+        const auto& counters = snapshot->counters;
+        logInfo() << (final ? "Statistics (final): " : "Statistics: ")
+                  << counters[HotStats::DirectoriesOpened] << " directories opened, "
+                  << counters[HotStats::EntriesRead] << " entries read, "
+                  << counters[HotStats::StatCalls] << " stat calls, "
+                  << formatFileSize(static_cast<double>(counters[HotStats::BytesAccounted])) << " accounted, "
+                  << counters[HotStats::Errors] << " errors, "
+                  << counters[HotStats::Deletions] << " deletions";
+
+        const char* phase_names[] = {"directory", "probe", "entry", "action", "round"};
+        for (size_t phase = 0; phase < HotStats::PHASE_COUNT; phase++) {
+            const auto& histogram = snapshot->histograms[phase];
+            uint64_t samples = 0;
+            for (uint64_t count : histogram) {
+                samples += count;
+            }
+            if (samples == 0) {
+                continue;
+            }
+            logInfo() << "  " << phase_names[phase] << ": " << samples << " samples"
+                      << ", p50 " << formatDuration(HotStats::quantile(histogram, 0.5))
+                      << ", p90 " << formatDuration(HotStats::quantile(histogram, 0.9))
+                      << ", p99 " << formatDuration(HotStats::quantile(histogram, 0.99))
+                      << ", max " << formatDuration(HotStats::quantile(histogram, 1.0));
+        }
+        #else
+        (void)final;
+        #endif
+    }
+
+    // Handle oversized file
+    static void handleOversizeFile(FileConfig& config, double current_size) {
+        FSM_STAT_SCOPE(Action);
+        logInfo() << "File exceeds size limit: " << config.path;
+        logInfo() << "  Current size: " << formatFileSize(current_size)
+                  << " | Limit: " << config.original_size_str
+                  << " | Action: " << config.action;
+
+        if (config.action == "trash") {
+            logInfo() << "Deleting file...";
+            if (deleteFile(config.path)) {
+                config.has_warned = true;
+                metrics().countAction(MetricsRegistry::Action::Trash);
+            }
+        } else {
+            // warn action, just log warning
+            if (!config.has_warned) {
+                logInfo() << "Warning: File " << config.path << " has exceeded size limit!";
+                config.has_warned = true;
+                metrics().countAction(MetricsRegistry::Action::Warn);
+            }
+        }
+    }
+
+    // Handle oversized file or directory
+    static void handleOversizePath(FileConfig& config, double current_size) {
+        FSM_STAT_SCOPE(Action);
+        #ifdef FSM_BENCHMARK
+        if (bench_on_oversize) {
+            bench_on_oversize(config.path);
+        }
+        #endif
+        logInfo() << "Directory exceeds size limit: " << config.path;
+        logInfo() << "  Current size: " << formatFileSize(current_size)
+                  << " | Limit: " << config.original_size_str
+                  << " | Action: " << config.action;
+
+        if (config.action == "trash") {
+            logInfo() << "Trashing directory contents...";
+            if (trashDirectory(config.path, config.pace)) {
+                config.has_warned = true;
+                metrics().countAction(MetricsRegistry::Action::Trash);
+            }
+            if (config.size_tree) {
+                config.size_tree->invalidate();
+            }
+        } else if (config.action == "evict") {
+            if (config.evicting->exchange(true)) {
+                logInfo() << "Eviction already in progress for: " << config.path;
+                return;
+            }
+            logInfo() << "Evicting oldest files down to " << formatFileSize(config.low_watermark_bytes) << "...";
+            auto evicting = config.evicting;
+            std::string path = config.path;
+            double low_watermark = config.low_watermark_bytes;
+            bool by_atime = config.evict_by_atime;
+            DeletionPace pace = config.pace;
+            trashQueue().enqueue({path, [=](const std::atomic<bool>& cancel) {
+                evictOldest(path, low_watermark, by_atime, pace, cancel);
+                evicting->store(false);
+            }});
+            config.has_warned = true;
+            metrics().countAction(MetricsRegistry::Action::Evict);
+        } else {
+            // warn action, just log warning
+            if (!config.has_warned) {
+                logInfo() << "Warning: Directory " << config.path << " has exceeded size limit!";
+                // Take detailed statistics from the size tree, or calculate them
+                DirectorySizeResult result = config.size_tree ? config.size_tree->totals() : calculateDirectorySize(config.path);
+                logInfo() << "  Detailed info: " << result.file_count << " files, " 
+                          << result.folder_count << " folders";
+                config.has_warned = true;
+                metrics().countAction(MetricsRegistry::Action::Warn);
+            }
+        }
+    }
+
+    // Event kinds of the structured output; the values are the binary record codes
+    enum class EntryEvent : uint8_t {
+        Observed = 1,  // First measurement of an entry
+        Size = 2,      // Size changed by at least the delta
+        Exceeded = 3,  // Crossed the limit
+        Recovered = 4, // Back under the limit
+        Missing = 5,   // The path disappeared
+        Appeared = 6,  // The path is back
+        TimedOut = 7   // The scan ran past its deadline
+    };
+
+    static const char* eventName(EntryEvent event) {
+        switch (event) {
+            case EntryEvent::Observed: return "observed";
+            case EntryEvent::Size: return "size";
+            case EntryEvent::Exceeded: return "exceeded";
+            case EntryEvent::Recovered: return "recovered";
+            case EntryEvent::Missing: return "missing";
+            case EntryEvent::Appeared: return "appeared";
+            default: return "timeout";
+        }
+    }
+
+    // Writes event records to a file, FIFO or Unix socket ("unix:/path") from a background thread.
+    // The queue is bounded: when the reader falls behind, producers wait instead of losing records.
+    class EventSink {
+    public:
+        static constexpr size_t MAX_QUEUED = 4096;
+
+        explicit EventSink(std::string target) : target_(std::move(target)) {
+            #ifndef _WIN32
+            // A reader going away must be an error on write, not a fatal signal
+            std::signal(SIGPIPE, SIG_IGN);
+            #endif
+            writer_ = std::thread([this] { writerLoop(); });
+        }
+
+        ~EventSink() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            changed_.notify_all();
+            writer_.join();
+            closeTarget();
+        }
+
+        EventSink(const EventSink&) = delete;
+        EventSink& operator=(const EventSink&) = delete;
+
+        void push(std::string record) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (queue_.size() >= MAX_QUEUED) {
+                Tracer::Scope trace_scope("event queue wait");
+                changed_.wait(lock, [this] { return queue_.size() < MAX_QUEUED || stop_; });
+            }
+            queue_.push_back(std::move(record));
+            changed_.notify_all();
+        }
+
+    private:
+        std::string target_;
+        std::mutex mutex_;
+        std::condition_variable changed_;
+        std::deque<std::string> queue_;
+        bool stop_ = false;
+        std::thread writer_;
+        #ifdef _WIN32
+        FILE* file_ = nullptr;
+        #else
+        int fd_ = -1;
+        #endif
+
+        void writerLoop() {
+            std::string batch;
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    changed_.wait(lock, [this] { return !queue_.empty() || stop_; });
+                    if (queue_.empty()) {
+                        return;
+                    }
+                    batch.clear();
+                    while (!queue_.empty()) {
+                        batch += queue_.front();
+                        queue_.pop_front();
+                    }
+                }
+                changed_.notify_all();
+
+                // Keep the batch until it is written; the queue fills up meanwhile and holds back the producers
+                while (!writeAll(batch)) {
+                    closeTarget();
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    if (changed_.wait_for(lock, std::chrono::seconds(1), [this] { return stop_; })) {
+                        return;
+                    }
+                }
+            }
+        }
+
+        bool openTarget() {
+            #ifdef _WIN32
+            if (!file_) {
+                file_ = _wfopen(utf8_to_wide(target_).c_str(), L"ab");
+            }
+            return file_ != nullptr;
+            #else
+            if (fd_ >= 0) {
+                return true;
+            }
+            if (target_.compare(0, 5, "unix:") == 0) {
+                sockaddr_un address{};
+                address.sun_family = AF_UNIX;
+                std::string path = target_.substr(5);
+                if (path.size() >= sizeof(address.sun_path)) {
+                    return false;
+                }
+                std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+                fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if (fd_ >= 0 && connect(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+                    closeTarget();
+                }
+            } else {
+                // Opening a FIFO blocks until a reader shows up, which is the backpressure we want
+                fd_ = open(target_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            }
+            return fd_ >= 0;
+            #endif
+        }
+
+        bool writeAll(const std::string& data) {
+            if (!openTarget()) {
+                return false;
+            }
+            #ifdef _WIN32
+            return std::fwrite(data.data(), 1, data.size(), file_) == data.size() && std::fflush(file_) == 0;
+            #else
+            size_t offset = 0;
+            while (offset < data.size()) {
+                ssize_t written = write(fd_, data.data() + offset, data.size() - offset);
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    // The reader is gone; the whole batch is sent again to the next one
+                    return false;
+                }
+                offset += static_cast<size_t>(written);
+            }
+            return true;
+            #endif
+        }
+
+        void closeTarget() {
+            #ifdef _WIN32
+            if (file_) {
+                std::fclose(file_);
+                file_ = nullptr;
+            }
+            #else
+            if (fd_ >= 0) {
+                close(fd_);
+                fd_ = -1;
+            }
+            #endif
+        }
+    };
+
+    static inline std::unique_ptr<EventSink> event_sink;
+    static inline bool binary_events = false;
+    static inline double event_delta_ratio = 0.01; // Of the limit, unless a size is given
+    static inline double event_delta_bytes = 0;
+
+    // Per-entry status lines only show at debug level while the event output replaces them
+    static LogLine logStatus() {
+        return LogLine(event_sink ? LogLevel::Debug : LogLevel::Info);
+    }
+
+    // Send an event when the state of an entry changed or its size moved by at least the delta
+    static void recordEntryState(size_t index, FileConfig& config, double current_size, bool timed_out, bool unvalidated = false) {
+        if (!event_sink) {
+            return;
+        }
+        bool missing = config.type == "path" ? current_size <= 0 : current_size < 0;
+        EntryState state = timed_out ? EntryState::TimedOut
+                         : missing   ? EntryState::Missing
+                         : current_size > config.max_size_bytes ? EntryState::Exceeded : EntryState::Ok;
+
+        EntryEvent event;
+        EntryState previous = config.reported_state;
+        if (state == previous) {
+            double delta = event_delta_bytes > 0 ? event_delta_bytes : config.max_size_bytes * event_delta_ratio;
+            if ((state != EntryState::Ok && state != EntryState::Exceeded) ||
+                std::abs(current_size - config.reported_size) < std::max(delta, 1.0)) {
+                return;
+            }
+            event = EntryEvent::Size;
+        } else if (state == EntryState::Exceeded) {
+            event = EntryEvent::Exceeded;
+        } else if (state == EntryState::Missing) {
+            event = EntryEvent::Missing;
+        } else if (state == EntryState::TimedOut) {
+            event = EntryEvent::TimedOut;
+        } else if (previous == EntryState::Exceeded) {
+            event = EntryEvent::Recovered;
+        } else if (previous == EntryState::Missing) {
+            event = EntryEvent::Appeared;
+        } else {
+            event = EntryEvent::Observed;
+        }
+
+        double previous_size = config.reported_size;
+        config.reported_state = state;
+        if (state == EntryState::Ok || state == EntryState::Exceeded) {
+            config.reported_size = current_size;
+        }
+        int64_t timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        int64_t size = state == EntryState::Ok || state == EntryState::Exceeded ? static_cast<int64_t>(current_size) : -1;
+        event_sink->push(binary_events ? binaryEvent(event, index, config, timestamp, size, static_cast<int64_t>(previous_size), unvalidated)
+                                       : jsonEvent(event, index, config, timestamp, size, static_cast<int64_t>(previous_size), unvalidated));
+    }
+
+    static std::string jsonEvent(EntryEvent event, size_t index, const FileConfig& config, int64_t timestamp, int64_t size, int64_t previous,
+                                 bool unvalidated) {
+        std::string line = "{\"ts\":";
+        LogLine::appendNumber(line, timestamp);
+        line += ",\"event\":\"";
+        line += eventName(event);
+        line += "\",\"entry\":";
+        LogLine::appendNumber(line, index);
+        line += ",\"type\":\"";
+        line += config.type;
+        line += "\",\"path\":";
+        appendJsonString(line, config.path);
+        line += ",\"size\":";
+        LogLine::appendNumber(line, size);
+        line += ",\"previous\":";
+        LogLine::appendNumber(line, previous);
+        line += ",\"limit\":";
+        LogLine::appendNumber(line, static_cast<int64_t>(config.max_size_bytes));
+        if (unvalidated) {
+            line += ",\"unvalidated\":true";
+        }
+        line += "}\n";
+        return line;
+    }
+
+    // Record: u32 length of the rest, then u8 version (1), u8 event, u8 type (0 file, 1 path), u8 flags (bit 0: size from
+    // a scan index not yet validated), i64 timestamp (ms), i64 size, i64 previous size, i64 limit, u32 entry, u16 path length,
+    // path; all little-endian
+    static std::string binaryEvent(EntryEvent event, size_t index, const FileConfig& config, int64_t timestamp, int64_t size, int64_t previous,
+                                   bool unvalidated) {
+        std::string record;
+        auto put = [&record](uint64_t value, int bytes) {
+            for (int i = 0; i < bytes; i++) {
+                record += static_cast<char>((value >> (8 * i)) & 0xFF);
+            }
+        };
+        size_t path_length = std::min<size_t>(config.path.size(), 0xFFFF);
+        put(4 + 4 * 8 + 4 + 2 + path_length, 4);
+        put(1, 1);
+        put(static_cast<uint8_t>(event), 1);
+        put(config.type == "path" ? 1 : 0, 1);
+        put(unvalidated ? 1 : 0, 1);
+        put(static_cast<uint64_t>(timestamp), 8);
+        put(static_cast<uint64_t>(size), 8);
+        put(static_cast<uint64_t>(previous), 8);
+        put(static_cast<uint64_t>(config.max_size_bytes), 8);
+        put(index, 4);
+        put(path_length, 2);
+        record.append(config.path, 0, path_length);
+        return record;
+    }
+
+    // Measure the current size of a configuration, from its size tree when one is maintained;
+    // safe to run concurrently for different entries
+    static void measureEntry(FileConfig& config, Measurement& result) {
+        FSM_STAT_SCOPE(Entry);
+        Tracer::Scope trace_scope("scan entry", config.path);
+        IdleIoScope idle_io(scan_idle_io);
+        auto start = std::chrono::steady_clock::now();
+        if (config.type == "path") {
+            DirectorySizeResult totals{0, 0, 0};
+            if (config.size_tree) {
+                // A validation in slices is carried on rather than restarted
+                if (config.validate_tree && !config.size_tree->validating()) {
+                    config.size_tree->revalidate();
+                }
+                config.size_tree->update();
+                totals = config.size_tree->totals();
+                result.unvalidated = config.size_tree->validating();
+            } else {
+                totals = calculateDirectorySize(config.path);
+            }
+            result.size = static_cast<double>(totals.total_size);
+            result.file_count = totals.file_count;
+            result.folder_count = totals.folder_count;
+        } else {
+            result.size = getCurrentFileSize(config.path);
+            result.file_count = result.size >= 0 ? 1 : 0;
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Check a single FILE type configuration
+    static void checkFileEntry(FileConfig& config, double current_size) {
+        if (current_size < 0) {
+            // File doesn't exist or error accessing it
+            config.has_warned = false; // Reset warning status
+            return;
+        }
+
+        bool exceeds = current_size > config.max_size_bytes;
+        logStatus() << "File: " << config.path
+                    << " | Current: " << formatFileSize(current_size)
+                    << " | Limit: " << config.original_size_str
+                    << " | Action: " << config.action
+                    << " | Status: " << (exceeds ? std::string("EXCEEDS LIMIT!") : formatFixed(current_size / config.max_size_bytes * 100.0, 2) + "%");
+
+        if (exceeds) {
+            handleOversizeFile(config, current_size);
+        } else {
+            config.has_warned = false; // Reset warning status
+        }
+    }
+
+    // Check a single PATH type configuration with the same output format as FILE type
+    static void checkPathEntry(FileConfig& config, double current_size, bool unvalidated = false) {
+        if (current_size <= 0) {
+            // Directory doesn't exist or error accessing it
+            config.has_warned = false; // Reset warning status
+            return;
+        }
+
+        bool exceeds = current_size > config.max_size_bytes;
+        logStatus() << "Directory: " << config.path
+                    << " | Current: " << formatFileSize(current_size)
+                    << " | Limit: " << config.original_size_str
+                    << " | Action: " << config.action
+                    << " | Status: " << (exceeds ? std::string("EXCEEDS LIMIT!") : formatFixed(current_size / config.max_size_bytes * 100.0, 2) + "%")
+                    << (unvalidated ? " | Index: not yet validated" : "");
+
+        if (exceeds && unvalidated) {
+            // Saved totals may be stale; nothing is deleted on their word
+            logInfo() << "  Action deferred until the scan index is validated: " << config.path;
+        } else if (exceeds) {
+            handleOversizePath(config, current_size);
+        } else {
+            config.has_warned = false; // Reset warning status
+        }
+    }
+
+    // Update the growth estimate of an entry and schedule its next check. With adaptive scheduling the
+    // next check comes at half the expected time until the threshold is reached, within the bounds.
+    void scheduleNextCheck(size_t index, double current_size, std::chrono::steady_clock::time_point now) {
+        FileConfig& config = file_configs[index];
+        CheckSchedule& schedule = config.schedule;
+        if (schedule.last_size >= 0 && current_size >= 0 && now > schedule.last_check) {
+            double elapsed = std::chrono::duration<double>(now - schedule.last_check).count();
+            double rate = (current_size - schedule.last_size) / elapsed;
+            // Exponentially weighted, so one burst does not dominate and a quiet spell decays the estimate
+            schedule.growth_rate = schedule.has_rate ? 0.7 * schedule.growth_rate + 0.3 * rate : rate;
+            schedule.has_rate = true;
+        }
+        schedule.last_size = current_size;
+        schedule.last_check = now;
+
+        double interval = static_cast<double>(config.interval_seconds > 0 ? config.interval_seconds : check_interval_seconds);
+        if (adaptive_scheduling && current_size >= 0) {
+            // A per-entry interval caps the adaptive one, so the entry is still checked within its SLA
+            double longest = config.interval_seconds > 0 ? std::min(config.interval_seconds, max_interval_seconds) : max_interval_seconds;
+            double shortest = std::min(static_cast<double>(min_interval_seconds), longest);
+            double headroom = config.max_size_bytes - current_size;
+            if (headroom <= 0) {
+                interval = shortest;
+            } else if (schedule.growth_rate <= 0) {
+                interval = longest;
+            } else {
+                interval = std::clamp(0.5 * headroom / schedule.growth_rate, shortest, longest);
+            }
+        }
+
+        // The first delay is a random phase within the interval, later ones vary by up to 10%,
+        // so entries loaded together do not keep firing in the same second
+        double jitter = schedule.scheduled ? std::uniform_real_distribution<double>(0.9, 1.1)(jitter_random)
+                                           : std::uniform_real_distribution<double>(0.0, 1.0)(jitter_random);
+        schedule.scheduled = true;
+        deferred_entries.erase(index); // A completed check replaces any deferral
+        double delay = std::chrono::duration<double>(now - timer_epoch).count() + interval * jitter - check_timers.now();
+        check_timers.schedule(index, static_cast<uint64_t>(std::max(1.0, std::ceil(delay))));
+    }
+
+    // Advance the check timers to the current time and collect the entries that became due;
+    // those that came due after being deferred are also added to deferred
+    std::set<size_t> dueEntries(std::chrono::steady_clock::time_point now, std::set<size_t>* deferred = nullptr) {
+        std::set<size_t> due;
+        uint64_t tick = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(now - timer_epoch).count());
+        check_timers.advance(tick, [&](size_t index) {
+            due.insert(index);
+            if (deferred_entries.erase(index) && deferred) {
+                deferred->insert(index);
+            }
+        });
+        return due;
+    }
+
+    // Schedule the next check of an entry at a fixed time, without touching its growth estimate.
+    // The entry comes due on the timer even where it is otherwise only checked on events.
+    void deferCheck(size_t index, std::chrono::steady_clock::time_point when) {
+        deferred_entries.insert(index);
+        double delay = std::chrono::duration<double>(when - timer_epoch).count() - check_timers.now();
+        check_timers.schedule(index, static_cast<uint64_t>(std::max(1.0, std::ceil(delay))));
+    }
+
+    // Resume the devices where any probe returned; a probe still hanging past the retry time is
+    // abandoned so the next due entry starts a new one, up to MAX_ABANDONED_PROBES per device
+    void probeDegradedMounts() {
+        auto now = std::chrono::steady_clock::now();
+        for (auto& [device, health] : mount_health) {
+            if (!health.degraded || (!health.probe && health.abandoned_probes.empty())) {
+                continue;
+            }
+            auto& abandoned = health.abandoned_probes;
+            size_t running_probes = abandoned.size();
+            abandoned.erase(std::remove_if(abandoned.begin(), abandoned.end(),
+                                           [](const auto& probe) { return probe->done.load(); }),
+                            abandoned.end());
+            bool responded = abandoned.size() < running_probes || (health.probe && health.probe->done.load());
+            if (responded) {
+                logInfo() << "Mount of device " << deviceName(device) << " responds again, resuming checks";
+                health.degraded = false;
+                health.timeouts = 0;
+                health.probe.reset();
+                abandoned.clear();
+                // Entries that were put off are due right away
+                for (size_t i = 0; i < file_configs.size(); i++) {
+                    if (file_configs[i].device_known && file_configs[i].device == device) {
+                        deferCheck(i, now);
+                    }
+                }
+            } else if (health.probe && now >= health.retry_at && now - health.probe_started >= std::chrono::seconds(scan_timeout_seconds)) {
+                health.backoff_seconds = std::min(health.backoff_seconds * 2, MAX_BACKOFF_SECONDS);
+                health.retry_at = now + std::chrono::seconds(health.backoff_seconds);
+                if (abandoned.size() < MAX_ABANDONED_PROBES) {
+                    abandoned.push_back(std::move(health.probe));
+                    health.probe.reset();
+                    logWarning() << "Warning: Mount of device " << deviceName(device) << " still does not respond, retrying in "
+                                 << health.backoff_seconds << " seconds";
+                } else {
+                    logWarning() << "Warning: Mount of device " << deviceName(device) << " still does not respond, "
+                                 << abandoned.size() + 1 << " probes outstanding; it stays degraded until one of them returns";
+                }
+            }
+        }
+    }
+
+    // Count the timeouts of a check round per device; a device degrades after repeated timeouts
+    void updateMountHealth(const std::vector<size_t>& order, const std::set<size_t>& timed_out, const std::set<size_t>& skipped) {
+        std::unordered_map<uint64_t, size_t> timeouts;
+        std::set<uint64_t> completed;
+        for (size_t index : order) {
+            if (timed_out.count(index)) {
+                timeouts[file_configs[index].device]++;
+            } else if (!skipped.count(index)) {
+                completed.insert(file_configs[index].device);
+            }
+        }
+
+        for (uint64_t device : completed) {
+            if (!timeouts.count(device)) {
+                // A clean round: forget earlier timeouts and restart the backoff
+                mount_health[device] = MountHealth{};
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        for (const auto& [device, count] : timeouts) {
+            MountHealth& health = mount_health[device];
+            health.timeouts += count;
+            if (health.degraded || health.timeouts < TIMEOUTS_BEFORE_DEGRADED) {
+                continue;
+            }
+            health.degraded = true;
+            health.backoff_seconds = health.backoff_seconds > 0 ? std::min(health.backoff_seconds * 2, MAX_BACKOFF_SECONDS)
+                                                                : std::min(std::max(30, scan_timeout_seconds), MAX_BACKOFF_SECONDS);
+            health.retry_at = now + std::chrono::seconds(health.backoff_seconds);
+            logWarning() << "Warning: Mount of device " << deviceName(device) << " is degraded after " << health.timeouts
+                         << " scan timeouts, retrying in " << health.backoff_seconds << " seconds";
+        }
+    }
+
+    // A scan that ran past the deadline; its worker is left behind and the entry is retried later
+    void reportTimeout(size_t index) {
+        FileConfig& config = file_configs[index];
+        MountHealth& health = mount_health[config.device];
+        recordEntryState(index, config, -1, true);
+        logInfo() << (config.type == "path" ? "Directory: " : "File: ") << config.path
+                  << " | Limit: " << config.original_size_str
+                  << " | Action: " << config.action
+                  << " | Status: SCAN TIMED OUT after " << scan_timeout_seconds << "s";
+        if (config.size_tree) {
+            // The stuck worker still holds the old tree; start over with a fresh one
+            config.size_tree = std::make_shared<DirectorySizeTree>(config.path);
+        }
+        deferCheck(index, health.degraded ? health.retry_at : std::chrono::steady_clock::now() + std::chrono::seconds(scan_timeout_seconds));
+    }
+
+    static std::string deviceName(uint64_t device) {
+        #ifdef __linux__
+        return std::to_string(major(static_cast<dev_t>(device))) + ":" + std::to_string(minor(static_cast<dev_t>(device)));
+        #else
+        return std::to_string(device);
+        #endif
+    }
+
+    // Seconds after which a single scan is given up, its mount counted as slow
+    static void setScanTimeout(int seconds) {
+        scan_timeout_seconds = std::max(1, seconds);
+    }
 
-        // Read the entire file content
-        std::string content;
-        file.seekg(0, std::ios::end);
-        content.resize(file.tellg());
-        file.seekg(0, std::ios::beg);
-        file.read(&content[0], content.size());
-        file.close();
+    // Number of threads measuring due entries concurrently, 0 selects twice the usable CPUs
+    static void setCheckThreads(int thread_count) {
+        check_threads = thread_count > 0 ? static_cast<size_t>(thread_count) : 0;
+    }
 
-        // Remove UTF-8 BOM if present
-        if (content.size() >= 3 &&
-            static_cast<unsigned char>(content[0]) == 0xEF &&
-            static_cast<unsigned char>(content[1]) == 0xBB &&
-            static_cast<unsigned char>(content[2]) == 0xBF) {
-            content = content.substr(3);
-        }
+    // Enable growth-based scheduling between the given bounds (seconds)
+    void setAdaptiveScheduling(bool enabled, int min_interval, int max_interval) {
+        adaptive_scheduling = enabled;
+        min_interval_seconds = std::max(1, min_interval);
+        max_interval_seconds = std::max(min_interval_seconds, max_interval);
+    }
 
-        // Process each line
-        std::istringstream iss(content);
-        std::string line;
-        int line_num = 0;
-        bool first_line = true;
+    // Check the given configurations - process file type first
+    void checkEntries(const std::set<size_t>& indices) {
+        FSM_STAT_SCOPE(Round);
+        Tracer::Scope trace_scope("check round");
+        auto now = std::chrono::system_clock::now();
+        std::time_t now_time = std::chrono::system_clock::to_time_t(now);
 
-        while (std::getline(iss, line)) {
-            line_num++;
+        std::string check_time = std::ctime(&now_time);
+        check_time.pop_back(); // ctime ends with a newline
+        logStatus() << "\nCheck time: " << check_time;
 
-            // Remove any carriage return characters (for Windows line endings)
-            if (!line.empty() && line.back() == '\r') {
-                line.pop_back();
+        // Measure on the workers with bounded concurrency per device, then report in configuration order.
+        // Entries of a degraded device wait until a background probe finds the mount responsive again.
+        probeDegradedMounts();
+        auto steady_now = std::chrono::steady_clock::now();
+        std::vector<size_t> order;
+        DeviceBoundedPool pool(effectiveCheckThreads(), std::chrono::seconds(scan_timeout_seconds), TIMEOUTS_BEFORE_DEGRADED);
+        for (size_t index : indices) {
+            FileConfig& config = file_configs[index];
+            if (!config.device_known) {
+                config.device = deviceOf(config.path);
+                config.device_limit = deviceConcurrency(config.path);
+                config.device_known = true;
             }
-
-            // Skip empty lines
-            if (line.empty()) {
+            MountHealth& health = mount_health[config.device];
+            bool stuck = config.measuring && !config.measuring->done.load();
+            if (health.degraded) {
+                if (!health.probe && !stuck && steady_now >= health.retry_at) {
+                    // Probe in the background, the round does not wait for a mount that may still hang
+                    auto probe = std::make_shared<Measurement>();
+                    health.probe = probe;
+                    health.probe_started = steady_now;
+                    FileConfig snapshot = config;
+                    if (snapshot.size_tree) {
+                        // A probe may hang past its retry and run beside the next one; it must not share the live tree
+                        snapshot.size_tree = std::make_shared<DirectorySizeTree>(config.path);
+                    }
+                    std::thread([snapshot, probe]() mutable {
+                        measureEntry(snapshot, *probe);
+                        probe->done.store(true);
+                    }).detach();
+                }
+                deferCheck(index, std::max(health.retry_at, steady_now + std::chrono::seconds(scan_timeout_seconds)));
                 continue;
             }
-
-            // Skip first line (header)
-            if (first_line) {
-                first_line = false;
+            if (stuck) {
+                // An earlier scan of this entry has not returned yet
+                deferCheck(index, steady_now + std::chrono::seconds(scan_timeout_seconds));
                 continue;
             }
 
-            // Parse TSV line format: fields separated by tabs
-            std::vector<std::string> fields;
-            std::istringstream lineStream(line);
-            std::string field;
-            
-            while (std::getline(lineStream, field, '\t')) {
-                // Trim whitespace from field
-                field.erase(0, field.find_first_not_of(" \t"));
-                field.erase(field.find_last_not_of(" \t") + 1);
-                fields.push_back(field);
+            auto result = std::make_shared<Measurement>();
+            config.measuring = result;
+            FileConfig snapshot = config;
+            pool.add(config.device, config.device_limit, index, [snapshot, result]() mutable {
+                measureEntry(snapshot, *result);
+                result->done.store(true);
+            });
+            order.push_back(index);
+        }
+
+        auto round_start = std::chrono::steady_clock::now();
+        DeviceBoundedPool::Outcome outcome = pool.run();
+        metrics().recordRound(order.size() - outcome.timed_out.size() - outcome.skipped.size(),
+                              std::chrono::duration<double>(std::chrono::steady_clock::now() - round_start).count());
+        // Keyed by the entries of this round only, so a small round stays cheap with many entries configured
+        std::set<size_t> timed_out(outcome.timed_out.begin(), outcome.timed_out.end());
+        std::set<size_t> skipped(outcome.skipped.begin(), outcome.skipped.end());
+        std::unordered_map<size_t, std::shared_ptr<Measurement>> results;
+        results.reserve(order.size());
+        for (size_t index : order) {
+            FileConfig& config = file_configs[index];
+            if (!timed_out.count(index) && !skipped.count(index)) {
+                results[index] = std::move(config.measuring);
+            } else if (skipped.count(index)) {
+                config.measuring.reset();
             }
+        }
+        updateMountHealth(order, timed_out, skipped);
 
-            if (fields.size() < 3) {
-                std::cerr << "Warning: Line " << line_num << " has incorrect format, skipping. Fields found: " << fields.size() << std::endl;
-                std::cerr << "Line content: " << line << std::endl;
-                continue;
+        for (size_t index : skipped) {
+            deferCheck(index, mount_health[file_configs[index].device].retry_at);
+        }
+        order.erase(std::remove_if(order.begin(), order.end(), [&skipped](size_t index) { return skipped.count(index) > 0; }), order.end());
+        for (size_t index : order) {
+            if (!timed_out.count(index) && results[index]->size <= 0) {
+                // Missing or empty now; look the device up again next time in case it is remounted
+                file_configs[index].device_known = false;
             }
+        }
 
-            std::string file_path = fields[0];
-            std::string size_str = fields[1];
-            std::string action_str = fields[2];
-            std::string type = "file"; // Default type is file
-        
-            // If there's a type column, read its value
-            if (fields.size() >= 4) {
-                type = fields[3];
-                // Convert to lowercase for comparison
-                std::transform(type.begin(), type.end(), type.begin(), ::tolower);
-                // Ensure type is either file or path
-                if (type != "file" && type != "path") {
-                    std::cerr << "Warning: Invalid type '" << type << "' in line " << line_num 
-                              << ", using 'file' as default" << std::endl;
-                    type = "file";
+        // Process FILE type configurations
+        logStatus() << "\nProcessing FILE type configurations:";
+        for (size_t index : order) {
+            if (file_configs[index].type == "file") {
+                if (timed_out.count(index)) {
+                    reportTimeout(index);
+                    continue;
                 }
+                const Measurement& result = *results[index];
+                checkFileEntry(file_configs[index], result.size);
+                recordEntryState(index, file_configs[index], result.size, false);
+                metrics().recordEntry(index, file_configs[index], result);
+                scheduleNextCheck(index, result.size, std::chrono::steady_clock::now());
             }
-
-            // Normalize file path - replace forward slashes with backslashes on Windows
-            #ifdef _WIN32
-            std::replace(file_path.begin(), file_path.end(), '/', '\\');
-            #endif
-
-            double max_bytes = parseSizeString(size_str);
-            std::string action = parseAction(action_str);
-
-            file_configs.push_back({file_path, max_bytes, size_str, action, false, type});
-
-            std::cout << "Loaded config: " << file_path << " -> " << size_str
-                      << " [" << action << "] (type: " << type << ", " << max_bytes << " bytes)" << std::endl;
         }
 
-        std::cout << "Successfully loaded " << file_configs.size() << " file configurations" << std::endl;
-        return !file_configs.empty();
+        // Process PATH type configurations
+        logStatus() << "\nProcessing PATH type configurations:";
+        for (size_t index : order) {
+            if (file_configs[index].type == "path") {
+                if (timed_out.count(index)) {
+                    reportTimeout(index);
+                    continue;
+                }
+                const Measurement& result = *results[index];
+                checkPathEntry(file_configs[index], result.size, result.unvalidated);
+                recordEntryState(index, file_configs[index], result.size, false, result.unvalidated);
+                metrics().recordEntry(index, file_configs[index], result);
+                scheduleNextCheck(index, result.size, std::chrono::steady_clock::now());
+                if (result.unvalidated) {
+                    // Each check validates one more slice of the indexed tree, so come back soon until it is done
+                    deferCheck(index, std::chrono::steady_clock::now() + std::chrono::seconds(1));
+                }
+            }
+        }
     }
 
-    // Get current file size with proper encoding handling
-    static double getCurrentFileSize(const std::string& file_path) {
-        try {
-            #ifdef _WIN32
-            // On Windows, convert UTF-8 to wide string for filesystem operations
-            std::wstring wide_path = utf8_to_wide(file_path);
-            std::filesystem::path fs_path(wide_path);
-            #else
-            // On other systems, use the path directly
-            std::filesystem::path fs_path(file_path);
-            #endif
-
-            if (!std::filesystem::exists(fs_path)) {
-                std::cerr << "File does not exist: " << file_path << std::endl;
-                return -1.0;
-            }
+    // Check all file sizes
+    void checkAllFiles() {
+        std::set<size_t> indices;
+        for (size_t i = 0; i < file_configs.size(); i++) {
+            indices.insert(i);
+        }
+        checkEntries(indices);
+    }
 
-            if (!std::filesystem::is_regular_file(fs_path)) {
-                std::cerr << "Path is not a regular file: " << file_path << std::endl;
-                return -1.0;
-            }
+    // Format file size for display
+    static std::string formatFileSize(double size_bytes) {
+        const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+        int unit_index = 0;
+        double size = size_bytes;
 
-            return static_cast<double>(std::filesystem::file_size(fs_path));
-        } catch (const std::filesystem::filesystem_error& e) {
-            std::cerr << "Filesystem error for '" << file_path << "': " << e.what() << std::endl;
-            return -1.0;
-        } catch (const std::exception& e) {
-            std::cerr << "Error getting file size for '" << file_path << "': " << e.what() << std::endl;
-            return -1.0;
+        while (size >= 1024.0 && unit_index < 4) {
+            size /= 1024.0;
+            unit_index++;
         }
-    }
 
-    // Structure for directory size calculation results
-    struct DirectorySizeResult {
-        uintmax_t total_size;  // Total size in bytes
-        size_t file_count;     // Number of files
-        size_t folder_count;   // Number of subdirectories
-    };
+        return formatFixed(size, 2) + " " + units[unit_index];
+    }
 
-    // Get directory size with proper encoding handling
-    static double getDirectorySize(const std::string& dir_path) {
-        DirectorySizeResult result = calculateDirectorySize(dir_path);
-        return static_cast<double>(result.total_size);
+#ifdef __linux__
+    // Remote and userspace filesystems do not report changes made by other hosts through inotify
+    // Looked up in the mount table rather than with statfs, which would block on a hung mount
+    static bool isEventCapableFilesystem(const std::string& path) {
+        return !isNetworkFilesystem(findMount(path).fs_type);
     }
 
-    // Internal implementation to calculate directory size and return complete statistics
-    static DirectorySizeResult calculateDirectorySize(const std::string& dir_path) {
-        DirectorySizeResult result{0, 0, 0};
-        
-        if (!std::filesystem::exists(dir_path)) {
-            std::cerr << "Path does not exist: " << dir_path << std::endl;
-            return result;
-        }
-        
-        try {
-            auto options = std::filesystem::directory_options::none;
-                
-            for (const auto& entry : std::filesystem::recursive_directory_iterator(dir_path, options)) {
-                try {
-                    if (std::filesystem::is_regular_file(entry)) {
-                        result.total_size += std::filesystem::file_size(entry);
-                        result.file_count++;
-                    } else if (std::filesystem::is_directory(entry)) {
-                        result.folder_count++;
-                    }
-                } catch (const std::filesystem::filesystem_error& ex) {
-                    // Ignore permission issues or other errors, continue with other files
-                    std::cerr << "Error: " << ex.what() << std::endl;
-                }
+    // Add (or share) a watch on a directory, returns the watch descriptor or -1
+    int addDirectoryWatch(const std::string& dir_path) {
+        int wd = inotify_add_watch(inotify_fd, dir_path.c_str(), WATCH_MASK);
+        if (wd < 0) {
+            if (errno == ENOSPC) {
+                logWarning() << "Warning: inotify watch limit reached (fs.inotify.max_user_watches) at: " << dir_path;
             }
-        } catch (const std::filesystem::filesystem_error& ex) {
-            std::cerr << "Error: " << ex.what() << std::endl;
+            return -1;
         }
-        
-        return result;
+        watches[wd].dir_path = dir_path;
+        return wd;
     }
 
-    // Delete file with proper encoding handling using system command
-    static bool deleteFileWithSystem(const std::string& file_path) {
-        try {
-            #ifdef _WIN32
-            // On Windows, use direct del command without cmd.exe
-            std::string command = "del /f /q \"" + file_path + "\"";
-            int result = system(command.c_str());
-            if (result == 0) {
-                std::cout << "Successfully deleted file using system command: " << file_path << std::endl;
-                return true;
-            } else {
-                std::cerr << "Failed to delete file using system command: " << file_path << " (Error code: " << result << ")" << std::endl;
+    // Register watches for one configuration, returns false if the entry has to be polled
+    bool watchEntry(size_t index) {
+        const FileConfig& config = file_configs[index];
+
+        if (config.type == "file") {
+            // Watch the parent directory so creation, replacement and deletion of the file are all seen
+            std::filesystem::path fs_path(config.path);
+            std::string parent = fs_path.has_parent_path() ? fs_path.parent_path().string() : ".";
+            if (!isEventCapableFilesystem(parent)) {
                 return false;
             }
-            #else
-            // On other systems, use rm command
-            std::string command = "rm -f '" + file_path + "'";
-            int result = system(command.c_str());
-            if (result == 0) {
-                std::cout << "Successfully deleted file using system command: " << file_path << std::endl;
-                return true;
-            } else {
-                std::cerr << "Failed to delete file using system command: " << file_path << " (Error code: " << result << ")" << std::endl;
+            int wd = addDirectoryWatch(parent);
+            if (wd < 0) {
                 return false;
             }
-            #endif
-        } catch (const std::exception& e) {
-            std::cerr << "Exception while deleting file with system command '" << file_path << "': " << e.what() << std::endl;
+            watches[wd].file_owners.emplace_back(index, fs_path.filename().string());
+            return true;
+        }
+
+        if (!isEventCapableFilesystem(config.path)) {
+            return false;
+        }
+        int root_wd = addDirectoryWatch(config.path);
+        if (root_wd < 0) {
             return false;
         }
+        watches[root_wd].path_owners.push_back(index);
+        return watchSubdirectories(config.path, index);
     }
 
-    // Delete directory and create empty directory at the same location using system commands
-    static bool deleteDirectoryWithSystem(const std::string& dir_path) {
-        try {
-            #ifdef _WIN32
-            // On Windows, first delete all contents recursively without cmd.exe
-            std::string delete_command = "rd /s /q \"" + dir_path + "\"";
-            int delete_result = system(delete_command.c_str());
-            if (delete_result != 0) {
-                std::cerr << "Failed to delete directory using system command: " << dir_path << " (Error code: " << delete_result << ")" << std::endl;
-                return false;
+    // Watch every directory below dir_path on behalf of a PATH entry
+    bool watchSubdirectories(const std::string& dir_path, size_t index) {
+        std::error_code ec;
+        auto options = std::filesystem::directory_options::skip_permission_denied;
+        for (std::filesystem::recursive_directory_iterator it(dir_path, options, ec), end; !ec && it != end; it.increment(ec)) {
+            if (!it->is_directory(ec) || it->is_symlink(ec)) {
+                continue;
             }
-            std::cout << "Successfully deleted directory using system command: " << dir_path << std::endl;
-
-            // Then create empty directory without cmd.exe
-            std::string create_command = "md \"" + dir_path + "\"";
-            int create_result = system(create_command.c_str());
-            if (create_result == 0) {
-                std::cout << "Successfully created empty directory at: " << dir_path << std::endl;
-                return true;
-            } else {
-                std::cerr << "Failed to create empty directory at: " << dir_path << " (Error code: " << create_result << ")" << std::endl;
-                return false;
+            if (it->path().filename() == GRAVEYARD_NAME) {
+                it.disable_recursion_pending();
+                continue;
             }
-            #else
-            // On other systems, use rm -rf to delete and mkdir to create
-            std::string delete_command = "rm -rf '" + dir_path + "'";
-            int delete_result = system(delete_command.c_str());
-            if (delete_result != 0) {
-                std::cerr << "Failed to delete directory using system command: " << dir_path << " (Error code: " << delete_result << ")" << std::endl;
+            int wd = addDirectoryWatch(it->path().string());
+            if (wd < 0) {
                 return false;
             }
-            std::cout << "Successfully deleted directory using system command: " << dir_path << std::endl;
+            auto& owners = watches[wd].path_owners;
+            if (std::find(owners.begin(), owners.end(), index) == owners.end()) {
+                owners.push_back(index);
+            }
+        }
+        return true;
+    }
 
-            std::string create_command = "mkdir -p '" + dir_path + "'";
-            int create_result = system(create_command.c_str());
-            if (create_result == 0) {
-                std::cout << "Successfully created empty directory at: " << dir_path << std::endl;
-                return true;
+    // Drop all watches held by one configuration
+    void unwatchEntry(size_t index) {
+        for (auto it = watches.begin(); it != watches.end();) {
+            auto& info = it->second;
+            info.path_owners.erase(std::remove(info.path_owners.begin(), info.path_owners.end(), index), info.path_owners.end());
+            info.file_owners.erase(std::remove_if(info.file_owners.begin(), info.file_owners.end(),
+                                                  [index](const auto& owner) { return owner.first == index; }),
+                                   info.file_owners.end());
+            if (info.path_owners.empty() && info.file_owners.empty()) {
+                inotify_rm_watch(inotify_fd, it->first);
+                it = watches.erase(it);
             } else {
-                std::cerr << "Failed to create empty directory at: " << dir_path << " (Error code: " << create_result << ")" << std::endl;
-                return false;
+                ++it;
             }
-            #endif
-        } catch (const std::exception& e) {
-            std::cerr << "Exception while deleting directory with system command '" << dir_path << "': " << e.what() << std::endl;
-            return false;
         }
     }
 
-    // Handle oversized file
-    static void handleOversizeFile(FileConfig& config, double current_size) {
-        std::cout << "File exceeds size limit: " << config.path << std::endl;
-        std::cout << "  Current size: " << formatFileSize(current_size)
-                  << " | Limit: " << config.original_size_str
-                  << " | Action: " << config.action << std::endl;
-
-        if (config.action == "trash") {
-            std::cout << "Deleting file..." << std::endl;
-            if (deleteFileWithSystem(config.path)) {
-                config.has_warned = true;
-            }
-        } else {
-            // warn action, just log warning
-            if (!config.has_warned) {
-                std::cout << "Warning: File " << config.path << " has exceeded size limit!" << std::endl;
-                config.has_warned = true;
-            }
+    // Re-register the watches of one configuration from scratch
+    void rewatchEntry(size_t index) {
+        FileConfig& config = file_configs[index];
+        unwatchEntry(index);
+        polled_entries[index] = !watchEntry(index);
+        if (polled_entries[index]) {
+            // Drop partial watches, the entry is polled until its watches are complete again
+            unwatchEntry(index);
+        }
+        if (config.type == "path") {
+            // Watches are in place before the walk, so nothing between the two is missed;
+            // a polled entry validates its tree before every check instead
+            attachSizeTree(config, polled_entries[index]);
         }
     }
 
-    // Handle oversized file or directory
-    static void handleOversizePath(FileConfig& config, double current_size) {
-        std::cout << "Directory exceeds size limit: " << config.path << std::endl;
-        std::cout << "  Current size: " << formatFileSize(current_size)
-                  << " | Limit: " << config.original_size_str
-                  << " | Action: " << config.action << std::endl;
+    // Set up inotify and watch all configurations
+    bool initEventEngine() {
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd < 0) {
+            logWarning() << "Warning: inotify_init1 failed: " << std::strerror(errno);
+            return false;
+        }
 
-        if (config.action == "trash") {
-            std::cout << "Deleting directory and creating empty directory..." << std::endl;
-            if (deleteDirectoryWithSystem(config.path)) {
-                config.has_warned = true;
-            }
-        } else {
-            // warn action, just log warning
-            if (!config.has_warned) {
-                std::cout << "Warning: Directory " << config.path << " has exceeded size limit!" << std::endl;
-                // Call calculateDirectorySize to get detailed statistics
-                DirectorySizeResult result = calculateDirectorySize(config.path);
-                std::cout << "  Detailed info: " << result.file_count << " files, " 
-                          << result.folder_count << " folders" << std::endl;
-                config.has_warned = true;
+        polled_entries.assign(file_configs.size(), false);
+        size_t polled = 0;
+        for (size_t i = 0; i < file_configs.size(); i++) {
+            rewatchEntry(i);
+            if (polled_entries[i]) {
+                polled++;
             }
         }
+
+        logInfo() << "Event engine ready: " << watches.size() << " directories watched, "
+                  << polled << " entries polled";
+        return true;
     }
 
-    // Check all file sizes - process file type first
-    void checkAllFiles() {
-        auto now = std::chrono::system_clock::now();
-        std::time_t now_time = std::chrono::system_clock::to_time_t(now);
+    // Release the inotify instance
+    void shutdownEventEngine() {
+        if (inotify_fd >= 0) {
+            close(inotify_fd);
+            inotify_fd = -1;
+        }
+        watches.clear();
+        rewatch_entries.clear();
+    }
 
-        std::cout << "\nCheck time: " << std::ctime(&now_time);
+    // Read all pending inotify events and collect the configurations they affect
+    void drainEvents(std::set<size_t>& dirty, bool& overflow) {
+        alignas(inotify_event) char buffer[64 * 1024];
 
-        // Process FILE type configurations
-        std::cout << "\nProcessing FILE type configurations:" << std::endl;
-        for (auto& config : file_configs) {
-            // Process FILE type configuration
-            if (config.type != "file") {
-                continue;
+        while (true) {
+            ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+            if (length <= 0) {
+                // EAGAIN: queue drained
+                return;
             }
 
-            double current_size = getCurrentFileSize(config.path);
+            for (char* ptr = buffer; ptr < buffer + length;) {
+                auto* event = reinterpret_cast<inotify_event*>(ptr);
+                ptr += sizeof(inotify_event) + event->len;
 
-            if (current_size < 0) {
-                // File doesn't exist or error accessing it
-                config.has_warned = false; // Reset warning status
-                continue;
-            }
+                if (event->mask & IN_Q_OVERFLOW) {
+                    overflow = true;
+                    continue;
+                }
+
+                auto it = watches.find(event->wd);
+                if (it == watches.end()) {
+                    continue;
+                }
+                std::string dir_path = it->second.dir_path;
+                std::vector<size_t> path_owners = it->second.path_owners;
+                std::string name = event->len > 0 ? std::string(event->name) : std::string();
+
+                for (size_t owner : path_owners) {
+                    dirty.insert(owner);
+                    if (file_configs[owner].size_tree) {
+                        file_configs[owner].size_tree->markDirty(dir_path);
+                    }
+                    if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)) && name != GRAVEYARD_NAME) {
+                        // New subtree: watch it before files appear in it, then rescan to catch what we missed
+                        std::string sub_dir = (std::filesystem::path(dir_path) / name).string();
+                        int wd = addDirectoryWatch(sub_dir);
+                        if (wd < 0 || (watches[wd].path_owners.push_back(owner), !watchSubdirectories(sub_dir, owner))) {
+                            rewatch_entries.insert(owner);
+                        }
+                    }
+                }
 
-            std::cout << "File: " << config.path
-                      << " | Current: " << formatFileSize(current_size)
-                      << " | Limit: " << config.original_size_str
-                      << " | Action: " << config.action
-                      << " | Status: ";
+                // Adding watches may have rehashed the map
+                it = watches.find(event->wd);
+                if (it == watches.end()) {
+                    continue;
+                }
 
-            if (current_size > config.max_size_bytes) {
-                std::cout << "EXCEEDS LIMIT!" << std::endl;
-                handleOversizeFile(config, current_size);
-            } else {
-                double percentage = (current_size / config.max_size_bytes) * 100.0;
-                std::cout << std::fixed << std::setprecision(2) << percentage << "%" << std::endl;
-                config.has_warned = false; // Reset warning status
+                for (const auto& owner : it->second.file_owners) {
+                    if (name.empty() || name == owner.second) {
+                        dirty.insert(owner.first);
+                    }
+                }
+
+                if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                    // The directory is gone or moved away; owners whose root depended on it must be rewatched
+                    for (size_t owner : it->second.path_owners) {
+                        if (file_configs[owner].path == it->second.dir_path) {
+                            rewatch_entries.insert(owner);
+                        }
+                    }
+                    for (const auto& owner : it->second.file_owners) {
+                        rewatch_entries.insert(owner.first);
+                    }
+                    if (event->mask & IN_IGNORED) {
+                        watches.erase(it);
+                    }
+                }
             }
         }
+    }
 
-        // Process PATH type configurations with the same output format as FILE type
-        std::cout << "\nProcessing PATH type configurations:" << std::endl;
-        for (auto& config : file_configs) {
-            // Process PATH type configuration
-            if (config.type != "path") {
-                continue;
-            }
+    // Event-driven loop: only entries whose watched subtree changed are re-evaluated
+    void runEventLoop() {
+        checkAllFiles();
 
-            double current_size = getDirectorySize(config.path);
+        std::set<size_t> dirty;
+        bool overflow = false;
+        auto interval = std::chrono::seconds(check_interval_seconds);
+        auto next_check = std::chrono::steady_clock::now() + interval;
+        auto next_watch_retry = next_check + std::chrono::minutes(1);
 
-            if (current_size <= 0) {
-                // Directory doesn't exist or error accessing it
-                config.has_warned = false; // Reset warning status
-                continue;
+        while (running) {
+            pollfd pfd{inotify_fd, POLLIN, 0};
+            int ready = poll(&pfd, 1, 1000);
+            if (ready > 0) {
+                drainEvents(dirty, overflow);
+            } else if (ready < 0 && errno != EINTR) {
+                logError() << "Error: poll on inotify failed: " << std::strerror(errno);
+                return;
             }
+            reloadConfigIfChanged(dirty);
 
-            std::cout << "Directory: " << config.path
-                      << " | Current: " << formatFileSize(current_size)
-                      << " | Limit: " << config.original_size_str
-                      << " | Action: " << config.action
-                      << " | Status: ";
-
-            if (current_size > config.max_size_bytes) {
-                std::cout << "EXCEEDS LIMIT!" << std::endl;
-                handleOversizePath(config, current_size);
-            } else {
-                double percentage = (current_size / config.max_size_bytes) * 100.0;
-                std::cout << std::fixed << std::setprecision(2) << percentage << "%" << std::endl;
-                config.has_warned = false; // Reset warning status
+            // Polled entries follow their own schedule, their watches are retried once a minute
+            auto now = std::chrono::steady_clock::now();
+            std::set<size_t> due;
+            std::set<size_t> deferred;
+            for (size_t index : dueEntries(now, &deferred)) {
+                // Event-driven entries come due on the timer only after a timeout, a stuck scan or a degraded device
+                if (polled_entries[index] || deferred.count(index)) {
+                    due.insert(index);
+                }
+            }
+            if (now >= next_watch_retry) {
+                next_watch_retry = now + std::chrono::minutes(1);
+                for (size_t i = 0; i < file_configs.size(); i++) {
+                    if (polled_entries[i]) {
+                        rewatchEntry(i);
+                    }
+                }
             }
-        }
-    }
 
-    // Format file size for display
-    static std::string formatFileSize(double size_bytes) {
-        const char* units[] = {"B", "KB", "MB", "GB", "TB"};
-        int unit_index = 0;
-        double size = size_bytes;
+            // Coalesce events so a busy directory is re-evaluated at most once per interval
+            if (now >= next_check) {
+                next_check = now + interval;
 
-        while (size >= 1024.0 && unit_index < 4) {
-            size /= 1024.0;
-            unit_index++;
-        }
+                if (overflow) {
+                    // Events were lost: rebuild the watches and rescan every event-driven entry once
+                    logWarning() << "Warning: inotify queue overflow, rescanning watched entries";
+                    drainEvents(dirty, overflow);
+                    overflow = false;
+                    for (size_t i = 0; i < file_configs.size(); i++) {
+                        if (!polled_entries[i]) {
+                            rewatch_entries.insert(i);
+                        }
+                    }
+                }
 
-        std::stringstream ss;
-        ss << std::fixed << std::setprecision(2) << size << " " << units[unit_index];
-        return ss.str();
+                for (size_t index : rewatch_entries) {
+                    rewatchEntry(index);
+                    dirty.insert(index);
+                }
+                rewatch_entries.clear();
+                due.insert(dirty.begin(), dirty.end());
+                dirty.clear();
+            }
+
+            std::set<size_t> warmup = takeWarmupEntries();
+            due.insert(warmup.begin(), warmup.end());
+            if (!due.empty()) {
+                checkEntries(due);
+            }
+            maybeSaveIndex(false);
+            reportStats(false);
+        }
     }
+#endif
 
     // Start monitoring
-    void startMonitoring(int check_interval_seconds = 5) {
+    void startMonitoring(int interval_seconds = 5) {
         running = true;
-        std::cout << "Starting file size monitoring, check interval: " << check_interval_seconds << " seconds" << std::endl;
-        std::cout << "Press Ctrl+C to stop monitoring" << std::endl;
+        check_interval_seconds = interval_seconds;
+        logInfo() << "Starting file size monitoring, check interval: " << check_interval_seconds << " seconds";
+        logInfo() << "Press Ctrl+C to stop monitoring";
+        Tracer::nameThread("monitor");
 
-        while (running) {
-            checkAllFiles();
+        recoverGraveyards();
+        loadIndex();
+
+#ifdef __linux__
+        // Prefer change notifications over re-stating everything on every tick
+        if (initEventEngine()) {
+            runEventLoop();
+            shutdownEventEngine();
+            maybeSaveIndex(true);
+            reportStats(true);
+            writeTrace();
+            return;
+        }
+        logWarning() << "Falling back to polling mode";
+#endif
 
-            // Wait for specified interval
-            for (int i = 0; i < check_interval_seconds && running; i++) {
-                std::this_thread::sleep_for(std::chrono::seconds(1));
+        // Without events every check validates the trees against directory timestamps
+        for (auto& config : file_configs) {
+            if (config.type == "path") {
+                attachSizeTree(config, true);
             }
         }
+        checkAllFiles();
+        while (running) {
+            // Wake up every second and check whatever is due
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            std::set<size_t> due = dueEntries(std::chrono::steady_clock::now());
+            reloadConfigIfChanged(due);
+            std::set<size_t> warmup = takeWarmupEntries();
+            due.insert(warmup.begin(), warmup.end());
+            if (running && !due.empty()) {
+                checkEntries(due);
+            }
+            maybeSaveIndex(false);
+            reportStats(false);
+        }
+        maybeSaveIndex(true);
+        reportStats(true);
+        writeTrace();
+    }
+
+    static void writeTrace() {
+        if (!trace_path.empty()) {
+            Tracer::write(trace_path);
+        }
     }
 
     // Stop monitoring
@@ -556,32 +6055,125 @@ void signalHandler(int signal) {
 }
 #endif
 
+#ifndef FSM_BENCHMARK
 int main(int argc, char* argv[]) {
     std::string tsv_file = "StatList.tsv";
 
+    // Options start with "--", the first other argument is the TSV file
+    int tsv_arg = 0;
+    bool adaptive = false;
+    int min_interval = 1;
+    int max_interval = 300;
+    std::string events_target;
+    bool events_binary = false;
+    std::string events_delta;
+    bool stats = false;
+    int stats_interval = 60;
+    int interval = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--scan-threads" && i + 1 < argc) {
+            FileSizeMonitor::setScanThreads(std::atoi(argv[++i]));
+        } else if (arg == "--delete-threads" && i + 1 < argc) {
+            FileSizeMonitor::setDeleteThreads(std::atoi(argv[++i]));
+        } else if (arg == "--scan-governor" && i + 1 < argc) {
+            FileSizeMonitor::setScanGovernor(argv[++i]);
+        } else if (arg == "--scan-timeout" && i + 1 < argc) {
+            FileSizeMonitor::setScanTimeout(std::atoi(argv[++i]));
+        } else if (arg == "--check-threads" && i + 1 < argc) {
+            FileSizeMonitor::setCheckThreads(std::atoi(argv[++i]));
+        } else if (arg == "--log-level" && i + 1 < argc) {
+            std::string level = argv[++i];
+            if (level == "debug") {
+                FileSizeMonitor::setLogLevel(FileSizeMonitor::LogLevel::Debug);
+            } else if (level == "info") {
+                FileSizeMonitor::setLogLevel(FileSizeMonitor::LogLevel::Info);
+            } else if (level == "warn" || level == "warning") {
+                FileSizeMonitor::setLogLevel(FileSizeMonitor::LogLevel::Warning);
+            } else if (level == "error") {
+                FileSizeMonitor::setLogLevel(FileSizeMonitor::LogLevel::Error);
+            } else {
+                std::cerr << "Warning: Unknown log level '" << level << "', using info" << std::endl;
+            }
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (arg == "--stats-interval" && i + 1 < argc) {
+            stats_interval = std::atoi(argv[++i]);
+        } else if (arg == "--trace" && i + 1 < argc) {
+            FileSizeMonitor::setTraceOutput(argv[++i]);
+        } else if (arg == "--index" && i + 1 < argc) {
+            FileSizeMonitor::setIndexFile(argv[++i]);
+        } else if (arg == "--trust-dir-mtime") {
+            FileSizeMonitor::setTrustDirMtime(true);
+        } else if (arg == "--metrics" && i + 1 < argc) {
+            FileSizeMonitor::setMetricsListener(argv[++i]);
+        } else if (arg == "--events" && i + 1 < argc) {
+            events_target = argv[++i];
+        } else if (arg == "--events-format" && i + 1 < argc) {
+            std::string format = argv[++i];
+            events_binary = format == "binary";
+            if (format != "binary" && format != "ndjson") {
+                std::cerr << "Warning: Unknown event format '" << format << "', using ndjson" << std::endl;
+            }
+        } else if (arg == "--events-delta" && i + 1 < argc) {
+            events_delta = argv[++i];
+        } else if (arg == "--interval" && i + 1 < argc) {
+            interval = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--adaptive") {
+            adaptive = true;
+        } else if (arg == "--min-interval" && i + 1 < argc) {
+            min_interval = std::atoi(argv[++i]);
+        } else if (arg == "--max-interval" && i + 1 < argc) {
+            max_interval = std::atoi(argv[++i]);
+        } else if (arg == "--scan-backend" && i + 1 < argc) {
+            std::string backend = argv[++i];
+            if (backend == "std") {
+                FileSizeMonitor::setScanBackend(FileSizeMonitor::ScanBackend::Filesystem);
+            } else if (backend == "raw") {
+                FileSizeMonitor::setScanBackend(FileSizeMonitor::ScanBackend::Raw);
+            } else if (backend == "uring") {
+                FileSizeMonitor::setScanBackend(FileSizeMonitor::ScanBackend::Uring);
+            } else if (backend != "auto") {
+                std::cerr << "Warning: Unknown scan backend '" << backend << "', using auto" << std::endl;
+            }
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Warning: Unknown or incomplete option '" << arg << "' ignored" << std::endl;
+        } else if (tsv_arg == 0) {
+            tsv_arg = i;
+        }
+    }
+
     // Allow specifying TSV file via command line argument
-    if (argc > 1) {
+    if (tsv_arg > 0) {
         // Ensure proper handling of Chinese paths in command line arguments
         #ifdef _WIN32
         // On Windows, argv might be in ANSI encoding, need to convert to UTF-8
-        int len = MultiByteToWideChar(CP_ACP, 0, argv[1], -1, nullptr, 0);
+        int len = MultiByteToWideChar(CP_ACP, 0, argv[tsv_arg], -1, nullptr, 0);
         if (len > 0) {
             std::wstring wide_path(len, 0);
-            MultiByteToWideChar(CP_ACP, 0, argv[1], -1, &wide_path[0], len);
+            MultiByteToWideChar(CP_ACP, 0, argv[tsv_arg], -1, &wide_path[0], len);
             
             // Convert from wide string to UTF-8
             FileSizeMonitor monitor_temp;
             tsv_file = FileSizeMonitor::wide_to_utf8(wide_path);
         }
         #else
-        tsv_file = argv[1];
+        tsv_file = argv[tsv_arg];
         #endif
     }
 
     FileSizeMonitor monitor;
+    monitor.setAdaptiveScheduling(adaptive, min_interval, max_interval);
+    if (!events_target.empty()) {
+        FileSizeMonitor::setEventOutput(events_target, events_binary, events_delta);
+    }
+    if (stats) {
+        FileSizeMonitor::setStatsReport(stats_interval);
+    }
 
     // Load configuration file
     if (!monitor.loadConfig(tsv_file)) {
+        FileSizeMonitor::flushLog();
         std::cerr << "Failed to load configuration file, program exiting" << std::endl;
         return 1;
     }
@@ -592,6 +6184,13 @@ int main(int argc, char* argv[]) {
     std::signal(SIGINT, signalHandler);
 #endif
 
+    FileSizeMonitor::flushLog();
+    if (interval > 0) {
+        // Interval given on the command line: run unattended
+        monitor.startMonitoring(interval);
+        return 0;
+    }
+
     std::cout << "\nSelect monitoring mode:" << std::endl;
     std::cout << "1. Regular check mode" << std::endl;
     std::cout << "2. Custom check interval" << std::endl;
@@ -605,7 +6204,6 @@ int main(int argc, char* argv[]) {
         monitor.startMonitoring(5); // Check every 5 seconds
     } else if (choice == 2) {
         std::cout << "Enter check interval (seconds): ";
-        int interval;
         std::cin >> interval;
         if (interval < 1) interval = 1;
         monitor.startMonitoring(interval);
@@ -615,4 +6213,5 @@ int main(int argc, char* argv[]) {
     }
 
     return 0;
-}
\ No newline at end of file
+}
+#endif